@@ -13,20 +13,75 @@ struct Voxel {
 };
 
 // mirrored with scene.h
-// size of the voxel chunk in one dimension
-const uint CHUNK_SIZE = 32;
+// The dimensions of the chunks, chosen at startup.
+layout(std430, binding = 10) readonly buffer ChunkInfo {
+    // size of the voxel chunk in one dimension
+    uint size;
+} chunkInfo;
+
+#define CHUNK_SIZE (chunkInfo.size)
 
 // mirrored with scene.h
+// One chunk per scene, more than one when baking several scenes at once,
+// each with CHUNK_SIZE^3 voxels indexed by voxelIndex().
 layout(std430, binding = 0) buffer Chunk {
-    Voxel[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE] voxels;
+    Voxel voxels[];
 } chunk;
 
+// mirrored with scene.h
+struct SceneState {
+    // sum of the luminance change of all updated faces during a frame, in 1 / SCENE_CHANGE_SCALE,
+    // as a 64-bit number split into the low and the high word
+    uint change[2];
+    // sum of the luminance of all updated faces during a frame, the same way
+    uint luminance[2];
+    // non-zero once the scene has converged, which stops its light updates
+    uint converged;
+};
+
+// mirrored with scene.h
+layout(std430, binding = 7) buffer SceneStates {
+    SceneState scenes[];
+} sceneStates;
+
+// The scene that getVoxel(), setColor() and faceIndex() refer to.
+// Compute shaders that process several scenes set this first.
+uint sceneIndex = 0;
+
+// mirrored with scene.h
+// Variance of the luminance of dbFaceColor per face, indexed by faceIndex().
+layout(std430, binding = 1) buffer FaceVariance {
+    float faces[];
+} faceVariance;
+
+// mirrored with scene.h
+// Denoised color (rgb) and variance (a) per face, indexed by faceIndex().
+layout(std430, binding = 2) buffer FilteredColor {
+    vec4 faces[];
+} filteredColor;
+
+// Index of a voxel within its scene.
+uint cellIndex(ivec3 index) {
+    uvec3 i = uvec3(index);
+    return (i.x * CHUNK_SIZE + i.y) * CHUNK_SIZE + i.z;
+}
+
+// Index of a voxel in chunk.voxels.
+uint voxelIndex(ivec3 index) {
+    return sceneIndex * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE + cellIndex(index);
+}
+
+// Index of a face in the per-face buffers.
+uint faceIndex(ivec3 index, uint face) {
+    return voxelIndex(index) * 6 + face;
+}
+
 bool bitFlag(uint flags, uint index) {
     return (flags & (1u << index)) == 1u;
 }
 
 Voxel getVoxel(ivec3 index) {
-    return chunk.voxels[index.x][index.y][index.z];
+    return chunk.voxels[voxelIndex(index)];
 }
 
 // returns true if VOXEL is solid
@@ -40,7 +95,141 @@ vec3 getColor(Voxel voxel, uint face) {
 
 void setColor(ivec3 index, uint face, vec3 color) {
     uint writeIdx = 1 - dbColorReadIdx;
-    chunk.voxels[index.x][index.y][index.z].dbFaceColor[face][writeIdx] = color;
+    chunk.voxels[voxelIndex(index)].dbFaceColor[face][writeIdx] = color;
+}
+
+vec3 getFilteredColor(ivec3 index, uint face) {
+    return filteredColor.faces[faceIndex(index, face)].rgb;
+}
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// mirrored with scene.h
+struct VoxelPriority {
+    // last frame in which a primary ray hit the voxel
+    uint seenFrame;
+    // last frame in which a ray from a seen voxel hit the voxel, in the slot of
+    // the frame's parity. A frame only reads the slot of the previous frame, so
+    // its own marks cannot change the priority of a voxel within the frame.
+    uint bounceFrames[2];
+    // last frame in which a light update pass handled the voxel, see countHandled()
+    uint handledFrame;
+};
+
+// mirrored with scene.h
+// Priority of the light updates of the displayed scene, indexed by cellIndex().
+layout(std430, binding = 9) buffer Priority {
+    // rays cast during the current frame, counted against the ray budget
+    uint raysUsed;
+    // voxels handled by the passes during the current frame and how many of
+    // them were handled more than once, only counted when checking the schedule
+    uint handled;
+    uint duplicates;
+    VoxelPriority voxels[];
+} priority;
+
+// mirrored with app.h
+// the voxels that a light update pass updates
+const uint UPDATE_ALL = 0;
+const uint UPDATE_HIGH_PRIORITY = 1;
+const uint UPDATE_LOW_PRIORITY = 2;
+
+void markSeen(ivec3 index, uint frame) {
+    priority.voxels[cellIndex(index)].seenFrame = frame;
+}
+
+void markBounce(ivec3 index, uint frame) {
+    priority.voxels[cellIndex(index)].bounceFrames[frame & 1] = frame;
+}
+
+// Returns true if a primary ray hit the voxel at INDEX during the frame before FRAME.
+bool isSeen(ivec3 index, uint frame) {
+    return priority.voxels[cellIndex(index)].seenFrame + 1 == frame;
+}
+
+// Returns true if the voxel at INDEX was seen or lit a seen voxel during the frame before FRAME.
+// Only depends on marks written before FRAME, so it does not change during the frame.
+bool isHighPriority(ivec3 index, uint frame) {
+    VoxelPriority voxel = priority.voxels[cellIndex(index)];
+    uint previous = frame - 1;
+    return voxel.seenFrame == previous || voxel.bounceFrames[previous & 1] == previous;
+}
+
+// Counts the voxel at INDEX as handled by a light update pass during FRAME.
+void countHandled(ivec3 index, uint frame) {
+    atomicAdd(priority.handled, 1);
+    if (atomicExchange(priority.voxels[cellIndex(index)].handledFrame, frame) == frame) {
+        atomicAdd(priority.duplicates, 1);
+    }
+}
+
+// Copies the colors of VOXEL at INDEX to the write half of the double buffer.
+void keepColors(ivec3 index, Voxel voxel) {
+    for (uint face = 0; face < 6; face++) {
+        setColor(index, face, getColor(voxel, face));
+    }
+}
+
+// Returns true if light update pass PASS updates VOXEL at INDEX during frame FRAME,
+// reserving RAY_COUNT rays of the per-frame BUDGET, where 0 means unlimited.
+// High priority voxels are updated every frame, the others take turns every INTERVAL frames.
+// Voxels that are skipped keep their colors. Counts the voxels each pass handles if CHECK is set.
+bool isScheduled(ivec3 index, Voxel voxel, uint pass, uint frame, uint interval, uint rayCount, uint budget, bool check) {
+    if (pass == UPDATE_ALL) {
+        return true;
+    }
+    bool high = isHighPriority(index, frame);
+    if (high != (pass == UPDATE_HIGH_PRIORITY)) {
+        // handled by the other pass
+        return false;
+    }
+    if (check) {
+        countHandled(index, frame);
+    }
+    bool turn = high || (cellIndex(index) + frame) % interval == 0;
+    if (!turn || (budget != 0 && atomicAdd(priority.raysUsed, rayCount) >= budget)) {
+        keepColors(index, voxel);
+        return false;
+    }
+    return true;
+}
+
+// mirrored with scene.h
+const float SCENE_CHANGE_SCALE = 1048576.0;
+
+// Converts VALUE to the fixed point of the scene sums, rounded to the nearest step.
+uint toSceneFixedPoint(float value) {
+    return uint(min(value * SCENE_CHANGE_SCALE + 0.5, 4294967295.0));
+}
+
+// Adds CHANGE and LUMINANCE to the sums of the current scene.
+// A low word that wraps around carries into the high word.
+void addSceneChange(float change, float luminance) {
+    uint c = toSceneFixedPoint(change);
+    if (atomicAdd(sceneStates.scenes[sceneIndex].change[0], c) > 0xFFFFFFFFu - c) {
+        atomicAdd(sceneStates.scenes[sceneIndex].change[1], 1);
+    }
+    uint l = toSceneFixedPoint(luminance);
+    if (atomicAdd(sceneStates.scenes[sceneIndex].luminance[0], l) > 0xFFFFFFFFu - l) {
+        atomicAdd(sceneStates.scenes[sceneIndex].luminance[1], 1);
+    }
+}
+
+// Blends COLOR, an estimate with variance SAMPLE_VARIANCE, into FACE of the voxel
+// at INDEX whose current color is PREVIOUS, and updates the variance of the face.
+// Sums the luminance change into sceneStates if TRACK is set.
+void blendFaceColor(ivec3 index, uint face, vec3 previous, vec3 color, float sampleVariance, float blendFactor, bool track) {
+    vec3 blended = mix(previous, color, blendFactor);
+    setColor(index, face, blended);
+    if (track) {
+        addSceneChange(luminance(abs(blended - previous)), luminance(blended));
+    }
+    // variance of the blended color, following the exponential moving average
+    uint i = faceIndex(index, face);
+    float keep = 1.0 - blendFactor;
+    faceVariance.faces[i] = keep * keep * faceVariance.faces[i] + blendFactor * blendFactor * sampleVariance;
 }
 
 struct Ray {
@@ -129,6 +318,15 @@ vec3 skyColor(vec3 direction) {
     return base + horizon + sun;
 }
 
+// Maps Linear RGB to sRGB
+// By Tynach from https://gamedev.stackexchange.com/questions/92015/optimized-linear-to-srgb-glsl
+vec3 toSRGB(vec3 linear) {
+    bvec3 cutoff = lessThan(linear, vec3(0.0031308));
+    vec3 higher = vec3(1.055)*pow(linear, vec3(1.0/2.4)) - vec3(0.055);
+    vec3 lower = linear * vec3(12.92);
+    return mix(higher, lower, cutoff);
+}
+
 // uses integer rounding to calculate the uint modulo `n mod m`
 uint umod(uint n, uint m) {
     return n - ((n / m) * m);
@@ -0,0 +1,116 @@
+// compute shader
+// One iteration of an edge-aware a-trous filter over the voxel faces.
+// Faces are blurred with coplanar exposed faces that share their normal,
+// weighted by how similar their materials are and by how much their luminance
+// differs relative to the tracked variance.
+#version 430
+
+// mirrored with VOXEL_WORKGROUP_SIZE in scene.h
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+
+#include "common.glsl"
+
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+
+// the distance between filter taps is 1 << iteration
+// the first iteration reads the raw colors instead of filterInput
+layout(location = 1) uniform uint iteration;
+
+// mirrored with scene.h
+layout(std430, binding = 3) readonly buffer FilterInput {
+    vec4 faces[];
+} filterInput;
+
+// mirrored with scene.h
+layout(std430, binding = 4) writeonly buffer FilterOutput {
+    vec4 faces[];
+} filterOutput;
+
+// B3-spline kernel
+const float KERNEL[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+// how strongly luminance differences stop the filter, in standard deviations
+const float LUMINANCE_SIGMA = 4.0;
+// how strongly diffuse color differences stop the filter
+const float MATERIAL_SIGMA = 8.0;
+
+// A face is exposed if the voxel is solid and the voxel in front of it is not.
+bool isExposed(ivec3 index, uint face) {
+    if (isOutOfBounds(index) || !isSolid(getVoxel(index))) {
+        return false;
+    }
+    ivec3 front = index + ivec3(voxelFaceToNormal(face));
+    return isOutOfBounds(front) || !isSolid(getVoxel(front));
+}
+
+// Color (rgb) and variance (a) of the input of this iteration.
+vec4 loadInput(ivec3 index, uint face) {
+    if (iteration == 0) {
+        return vec4(
+            chunk.voxels[voxelIndex(index)].dbFaceColor[face][dbColorReadIdx],
+            faceVariance.faces[faceIndex(index, face)]);
+    }
+    return filterInput.faces[faceIndex(index, face)];
+}
+
+void main() {
+    // scenes are stacked along z
+    sceneIndex = gl_GlobalInvocationID.z / CHUNK_SIZE;
+    ivec3 index = ivec3(gl_GlobalInvocationID.xy, gl_GlobalInvocationID.z % CHUNK_SIZE);
+    Voxel voxel = getVoxel(index);
+
+    // skip air voxels
+    if (!isSolid(voxel)) {
+        return;
+    }
+    int step = 1 << iteration;
+
+    for (uint face = 0; face < 6; face++) {
+        if (!isExposed(index, face)) {
+            continue;
+        }
+        vec4 center = loadInput(index, face);
+        // emitters have no noise
+        if (voxel.emission != vec3(0.0)) {
+            filterOutput.faces[faceIndex(index, face)] = vec4(voxel.emission, 0.0);
+            continue;
+        }
+        // the two axes along the face
+        uint dim = face / 2;
+        ivec3 tangent = ivec3(0);
+        ivec3 bitangent = ivec3(0);
+        tangent[(dim + 1) % 3] = step;
+        bitangent[(dim + 2) % 3] = step;
+
+        float centerLuminance = luminance(center.rgb);
+        float luminanceScale = 1.0 / (LUMINANCE_SIGMA * sqrt(center.a) + 1e-4);
+
+        vec3 color = vec3(0.0);
+        float variance = 0.0;
+        float totalWeight = 0.0;
+
+        for (int u = -2; u <= 2; u++) {
+            for (int v = -2; v <= 2; v++) {
+                ivec3 neighbor = index + tangent * u + bitangent * v;
+                if (!isExposed(neighbor, face)) {
+                    continue;
+                }
+                Voxel neighborVoxel = getVoxel(neighbor);
+                if (neighborVoxel.emission != vec3(0.0)) {
+                    continue;
+                }
+                vec4 tap = loadInput(neighbor, face);
+                float materialWeight = exp(-MATERIAL_SIGMA * distance(voxel.diffuse, neighborVoxel.diffuse));
+                float luminanceWeight = exp(-abs(luminance(tap.rgb) - centerLuminance) * luminanceScale);
+                float weight = KERNEL[abs(u)] * KERNEL[abs(v)] * materialWeight * luminanceWeight;
+
+                color += tap.rgb * weight;
+                variance += tap.a * weight * weight;
+                totalWeight += weight;
+            }
+        }
+        // the center tap always has a weight > 0
+        filterOutput.faces[faceIndex(index, face)] = vec4(
+            color / totalWeight,
+            variance / (totalWeight * totalWeight));
+    }
+}
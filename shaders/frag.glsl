@@ -11,15 +11,10 @@ out vec4 fragColor;
 layout(location = 1) uniform vec3 position;
 layout(location = 2) uniform mat3 rotation;
 layout(location = 3) uniform float aspectRatio;
-
-// Maps Linear RGB to sRGB
-// By Tynach from https://gamedev.stackexchange.com/questions/92015/optimized-linear-to-srgb-glsl
-vec3 toSRGB(vec3 linear) {
-    bvec3 cutoff = lessThan(linear, vec3(0.0031308));
-    vec3 higher = vec3(1.055)*pow(linear, vec3(1.0/2.4)) - vec3(0.055);
-    vec3 lower = linear * vec3(12.92);
-    return mix(higher, lower, cutoff);
-}
+// whether to display the denoised colors instead of the raw ones
+layout(location = 4) uniform bool useFiltered;
+// number of frames since start, recorded for the voxels that are seen
+layout(location = 5) uniform uint frameNumber;
 
 void main() {
     vec2 screenPos = (fragPos * 2.0 - 1.0) * vec2(aspectRatio, 1.0);
@@ -37,8 +32,14 @@ void main() {
 
     if (rayCast.hit) {
         ivec3 index = rayCast.voxelIndex;
-        Voxel hitVoxel = getVoxel(index);
-        color = getColor(hitVoxel, rayCast.face);
+        // prioritizes the light updates of the visible voxels
+        markSeen(index, frameNumber);
+        if (useFiltered) {
+            color = getFilteredColor(index, rayCast.face);
+        } else {
+            Voxel hitVoxel = getVoxel(index);
+            color = getColor(hitVoxel, rayCast.face);
+        }
     } else {
         color = skyColor(ray.direction);
     }
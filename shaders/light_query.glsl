@@ -0,0 +1,89 @@
+// compute shader
+// Evaluates a batch of light level queries against the current face colors.
+#version 430
+
+layout(local_size_x = 64) in;
+
+#include "common.glsl"
+
+// mirrored with light_query.h
+// face value marking a query for a point instead of a voxel face
+const uint LIGHT_QUERY_POINT = 6;
+
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+
+layout(location = 1) uniform uint queryCount;
+// whether to read the denoised colors instead of the raw ones
+layout(location = 2) uniform bool useFiltered;
+
+// mirrored with light_query.h
+struct LightQuery {
+    // a point, or the voxel index for face queries
+    vec3 position;
+    uint face;
+};
+
+// mirrored with scene.h
+layout(std430, binding = 5) readonly buffer LightQueries {
+    LightQuery queries[];
+} lightQueries;
+
+// mirrored with scene.h
+layout(std430, binding = 6) writeonly buffer LightQueryResults {
+    vec4 results[];
+} lightQueryResults;
+
+vec3 faceColor(ivec3 index, uint face) {
+    if (useFiltered) {
+        return getFilteredColor(index, face);
+    }
+    return getColor(getVoxel(index), face);
+}
+
+// Light level at a point.
+// Inside a solid voxel this is the average color of its exposed faces.
+// Elsewhere it is the average light arriving along the six axis directions.
+vec3 pointColor(vec3 point) {
+    if (isOutOfBounds(point)) {
+        return vec3(0.0);
+    }
+    ivec3 index = ivec3(floor(point));
+    bool solid = isSolid(getVoxel(index));
+    vec3 color = vec3(0.0);
+    uint count = 0;
+
+    for (uint face = 0; face < 6; face++) {
+        vec3 normal = voxelFaceToNormal(face);
+        if (solid) {
+            ivec3 front = index + ivec3(normal);
+            if (isOutOfBounds(front) || !isSolid(getVoxel(front))) {
+                color += faceColor(index, face);
+                count += 1;
+            }
+            continue;
+        }
+        RayCast rayCast = rayCast(Ray(point, normal));
+        color += rayCast.hit ? faceColor(rayCast.voxelIndex, rayCast.face) : skyColor(normal);
+        count += 1;
+    }
+    return count > 0 ? color / count : vec3(0.0);
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= queryCount) {
+        return;
+    }
+    LightQuery query = lightQueries.queries[i];
+    vec3 color = vec3(0.0);
+
+    if (query.face == LIGHT_QUERY_POINT) {
+        color = pointColor(query.position);
+    } else {
+        ivec3 index = ivec3(query.position);
+        if (!isOutOfBounds(index) && query.face < 6) {
+            color = faceColor(index, query.face);
+        }
+    }
+    lightQueryResults.results[i] = vec4(color, 1.0);
+}
@@ -1,6 +1,7 @@
 // compute shader
 #version 430
 
+// mirrored with VOXEL_WORKGROUP_SIZE in scene.h
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
 
 #include "common.glsl"
@@ -13,16 +14,37 @@ const uint RANDOM_DIRECTION_COUNT = 16;
 layout(location = 1) uniform uint frameNumber;
 // packed normalized vec3 directions
 layout(location = 2) uniform uint randomDirections[RANDOM_DIRECTION_COUNT];
+// whether light bounces off the denoised colors instead of the raw ones
+layout(location = 3) uniform bool useFilteredFeedback;
+// whether to sum the luminance change per scene into sceneStates
+layout(location = 4) uniform bool trackConvergence;
+// the voxels to update, UPDATE_ALL, UPDATE_HIGH_PRIORITY or UPDATE_LOW_PRIORITY
+layout(location = 5) uniform uint updatePass;
+// frames between updates of low priority voxels
+layout(location = 6) uniform uint priorityInterval;
+// rays that may be cast per frame, 0 for no limit
+layout(location = 7) uniform uint rayBudget;
+// whether to count the voxels that each pass handles
+layout(location = 8) uniform bool checkSchedule;
 
 // TODO: energy preservation or falloff term
 // TODO: specular and translucent surfaces?
 
+vec3 getFeedbackColor(ivec3 index, uint face) {
+    if (useFilteredFeedback) {
+        return getFilteredColor(index, face);
+    }
+    return getColor(getVoxel(index), face);
+}
+
 void main() {
-    ivec3 index = ivec3(gl_GlobalInvocationID);
+    // scenes are stacked along z
+    sceneIndex = gl_GlobalInvocationID.z / CHUNK_SIZE;
+    ivec3 index = ivec3(gl_GlobalInvocationID.xy, gl_GlobalInvocationID.z % CHUNK_SIZE);
     Voxel voxel = getVoxel(index);
 
-    // skip air voxels
-    if (!isSolid(voxel)) {
+    // skip air voxels and scenes that are done baking
+    if (!isSolid(voxel) || sceneStates.scenes[sceneIndex].converged != 0) {
         return;
     }
     uint seed = hash(uvec4(gl_GlobalInvocationID, frameNumber));
@@ -36,11 +58,22 @@ void main() {
         + (normal * 0.5001 + 0.5) // push to face surface
         + (normal.yzx * offset.x) + (normal.zxy * offset.y); // add offset on face
 
-    if (voxel.emission != vec3(0.0)) {
+    // emissive voxels cast no rays
+    bool emissive = voxel.emission != vec3(0.0);
+    uint rayCount = emissive ? 0 : RANDOM_DIRECTION_COUNT;
+    if (!isScheduled(index, voxel, updatePass, frameNumber, priorityInterval, rayCount, rayBudget, checkSchedule)) {
+        return;
+    }
+    if (emissive) {
         setColor(index, face, voxel.emission);
+        faceVariance.faces[faceIndex(index, face)] = 0.0;
         return;
     }
+    // the voxels that this voxel's light comes from have a high priority as well
+    bool seen = updatePass == UPDATE_HIGH_PRIORITY && isSeen(index, frameNumber);
     vec3 color = vec3(0.0);
+    // sum of the luminance and squared luminance of the samples
+    vec2 moments = vec2(0.0);
     uint samples = 0;
 
     for (int i = 0; i < RANDOM_DIRECTION_COUNT; i++) {
@@ -52,29 +85,34 @@ void main() {
         }
         direction = normalize(direction);
         Ray ray = Ray(position, direction);
+        vec3 incoming;
 
         if (isOutOfBounds(ray.origin)) {
-            color += skyColor(ray.direction) * voxel.diffuse;
-            samples += 1;
-            continue;
-        }
-        // fixes light leaking through 2+ voxel thick walls
-        if (isSolid(getVoxel(ivec3(ray.origin)))) {
-            continue;
-        }
-        RayCast rayCast = rayCast(ray);
-
-        if (!rayCast.hit) {
-            color += skyColor(ray.direction) * voxel.diffuse;
-            samples += 1;
+            incoming = skyColor(ray.direction);
+        } else if (isSolid(getVoxel(ivec3(ray.origin)))) {
+            // fixes light leaking through 2+ voxel thick walls
             continue;
+        } else {
+            RayCast rayCast = rayCast(ray);
+            if (seen && rayCast.hit) {
+                markBounce(rayCast.voxelIndex, frameNumber);
+            }
+            incoming = rayCast.hit
+                ? getFeedbackColor(rayCast.voxelIndex, rayCast.face)
+                : skyColor(ray.direction);
         }
-        color += getColor(getVoxel(rayCast.voxelIndex), rayCast.face) * voxel.diffuse;
+        vec3 sampleColor = incoming * voxel.diffuse;
+        float sampleLuminance = luminance(sampleColor);
+        color += sampleColor;
+        moments += vec2(sampleLuminance, sampleLuminance * sampleLuminance);
         samples += 1;
     }
     if (samples > 0) {
         const float BLEND_FACTOR = max(1.0 / sqrt(1.0 + frameNumber), 0.01);
         color /= samples;
-        setColor(index, face, mix(getColor(voxel, face), color, BLEND_FACTOR));
+        moments /= samples;
+        // variance of this frame's estimate, i.e. the mean of the samples
+        float sampleVariance = max(moments.y - moments.x * moments.x, 0.0) / samples;
+        blendFaceColor(index, face, getColor(voxel, face), color, sampleVariance, BLEND_FACTOR, trackConvergence);
     }
 }
@@ -0,0 +1,36 @@
+// fragment shader
+#version 430
+
+// only the visible fragments mark their voxel as seen
+layout(early_fragment_tests) in;
+
+in vec3 worldPos;
+flat in uint face;
+out vec4 fragColor;
+
+#include "common.glsl"
+
+// NOTE: names used for sync with CPU, do not change
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+// NOTE: location = 1 is already taken by viewProjection in mesh_vert.glsl
+// whether to display the denoised colors instead of the raw ones
+layout(location = 2) uniform bool useFiltered;
+// number of frames since start, recorded for the voxels that are seen
+layout(location = 3) uniform uint frameNumber;
+
+void main() {
+    // the voxel behind the face, found from the position on the merged quad
+    vec3 normal = voxelFaceToNormal(face);
+    ivec3 index = ivec3(floor(worldPos - normal * 0.5));
+    index = clamp(index, ivec3(0), ivec3(CHUNK_SIZE - 1));
+    // prioritizes the light updates of the visible voxels
+    markSeen(index, frameNumber);
+
+    vec3 color;
+    if (useFiltered) {
+        color = getFilteredColor(index, face);
+    } else {
+        color = getColor(getVoxel(index), face);
+    }
+    fragColor = vec4(toSRGB(color), 1.0);
+}
@@ -0,0 +1,19 @@
+// vertex shader
+#version 430
+
+// mirrored with MeshVertex in mesher.h
+in vec3 inPos;
+in uint inFace;
+
+out vec3 worldPos;
+flat out uint face;
+
+// NOTE: names used for sync with CPU, do not change
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+layout(location = 1) uniform mat4 viewProjection;
+
+void main() {
+    worldPos = inPos;
+    face = inFace;
+    gl_Position = viewProjection * vec4(inPos, 1.0);
+}
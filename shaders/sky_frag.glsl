@@ -0,0 +1,19 @@
+// fragment shader
+// Fills the background behind the rasterized voxel meshes.
+#version 430
+
+in vec2 fragPos;
+out vec4 fragColor;
+
+#include "common.glsl"
+
+// NOTE: names used for sync with CPU, do not change
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+layout(location = 2) uniform mat3 rotation;
+layout(location = 3) uniform float aspectRatio;
+
+void main() {
+    vec2 screenPos = (fragPos * 2.0 - 1.0) * vec2(aspectRatio, 1.0);
+    vec3 direction = rotation * normalize(vec3(screenPos.x, screenPos.y, -1.0));
+    fragColor = vec4(toSRGB(skyColor(direction)), 1.0);
+}
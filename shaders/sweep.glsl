@@ -0,0 +1,24 @@
+// Visibility found by sweep_visibility.glsl, shared with sweep_gather.glsl.
+
+// mirrored with app.h
+const uint RANDOM_DIRECTION_COUNT = 16;
+
+// mirrored with sweep.h
+// marks cells from which a direction leads out of the chunk
+const uint SWEEP_MISS = 0xFFFFFFFFu;
+
+// mirrored with scene.h
+// The first solid voxel in each random direction from every cell, as the
+// cellIndex() of the voxel * 8 + the face that is hit, or SWEEP_MISS.
+layout(std430, binding = 8) buffer SweepVisibility {
+    uint cells[];
+} sweepVisibility;
+
+ivec3 cellPosition(uint cell) {
+    return ivec3(cell / (CHUNK_SIZE * CHUNK_SIZE), (cell / CHUNK_SIZE) % CHUNK_SIZE, cell % CHUNK_SIZE);
+}
+
+// Index of the visibility from the cell at INDEX in random direction DIRECTION.
+uint sweepIndex(uint direction, ivec3 index) {
+    return (sceneIndex * RANDOM_DIRECTION_COUNT + direction) * (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE) + cellIndex(index);
+}
@@ -0,0 +1,113 @@
+// compute shader
+// Updates every exposed face of every voxel from the visibility found by
+// sweep_visibility.glsl, an alternative to light_update.glsl.
+#version 430
+
+// mirrored with VOXEL_WORKGROUP_SIZE in scene.h
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+
+#include "common.glsl"
+#include "sweep.glsl"
+
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+
+// number of frames since start
+layout(location = 1) uniform uint frameNumber;
+// packed normalized vec3 directions, the same ones as in sweep_visibility.glsl
+layout(location = 2) uniform uint randomDirections[RANDOM_DIRECTION_COUNT];
+// whether light bounces off the denoised colors instead of the raw ones
+layout(location = 3) uniform bool useFilteredFeedback;
+// whether to sum the luminance change per scene into sceneStates
+layout(location = 4) uniform bool trackConvergence;
+// the voxels to update, UPDATE_ALL, UPDATE_HIGH_PRIORITY or UPDATE_LOW_PRIORITY
+layout(location = 5) uniform uint updatePass;
+// frames between updates of low priority voxels
+layout(location = 6) uniform uint priorityInterval;
+// whether to count the voxels that each pass handles
+layout(location = 7) uniform bool checkSchedule;
+
+vec3 getFeedbackColor(ivec3 index, uint face) {
+    if (useFilteredFeedback) {
+        return getFilteredColor(index, face);
+    }
+    return getColor(getVoxel(index), face);
+}
+
+// Light arriving at the air cell at INDEX from random direction I.
+// Gives the voxel it comes from a high priority if SEEN is set.
+vec3 incomingColor(ivec3 index, uint i, vec3 direction, bool seen) {
+    if (isOutOfBounds(index)) {
+        return skyColor(direction);
+    }
+    uint hit = sweepVisibility.cells[sweepIndex(i, index)];
+    if (hit == SWEEP_MISS) {
+        return skyColor(direction);
+    }
+    ivec3 hitIndex = cellPosition(hit / 8);
+    if (seen) {
+        markBounce(hitIndex, frameNumber);
+    }
+    return getFeedbackColor(hitIndex, hit % 8);
+}
+
+void main() {
+    // scenes are stacked along z
+    sceneIndex = gl_GlobalInvocationID.z / CHUNK_SIZE;
+    ivec3 index = ivec3(gl_GlobalInvocationID.xy, gl_GlobalInvocationID.z % CHUNK_SIZE);
+    Voxel voxel = getVoxel(index);
+
+    // skip air voxels and scenes that are done baking
+    if (!isSolid(voxel) || sceneStates.scenes[sceneIndex].converged != 0) {
+        return;
+    }
+    // nothing is cast, so the ray budget does not apply
+    if (!isScheduled(index, voxel, updatePass, frameNumber, priorityInterval, 0, 0, checkSchedule)) {
+        return;
+    }
+    // the voxels that this voxel's light comes from have a high priority as well
+    bool seen = updatePass == UPDATE_HIGH_PRIORITY && isSeen(index, frameNumber);
+    const float BLEND_FACTOR = max(1.0 / sqrt(1.0 + frameNumber), 0.01);
+
+    for (uint face = 0; face < 6; face++) {
+        if (voxel.emission != vec3(0.0)) {
+            setColor(index, face, voxel.emission);
+            faceVariance.faces[faceIndex(index, face)] = 0.0;
+            continue;
+        }
+        vec3 normal = voxelFaceToNormal(face);
+        ivec3 front = index + ivec3(normal);
+        if (!isOutOfBounds(front) && isSolid(getVoxel(front))) {
+            // hidden face
+            continue;
+        }
+        vec3 color = vec3(0.0);
+        // weighted sum of the luminance and squared luminance of the samples
+        vec2 moments = vec2(0.0);
+        // sum of the weights and of the squared weights
+        vec2 weights = vec2(0.0);
+
+        // the directions are uniform on the sphere, so the ones in the hemisphere
+        // of the face are weighted by their cosine
+        for (uint i = 0; i < RANDOM_DIRECTION_COUNT; i++) {
+            vec3 direction = unpackSnorm4x8(randomDirections[i]).xyz;
+            float weight = dot(direction, normal);
+            if (weight <= 0.0) {
+                continue;
+            }
+            direction = normalize(direction);
+            vec3 sampleColor = incomingColor(front, i, direction, seen) * voxel.diffuse;
+            float sampleLuminance = luminance(sampleColor);
+            color += weight * sampleColor;
+            moments += weight * vec2(sampleLuminance, sampleLuminance * sampleLuminance);
+            weights += vec2(weight, weight * weight);
+        }
+        if (weights.x > 0.0) {
+            color /= weights.x;
+            moments /= weights.x;
+            // variance of the weighted mean, using the effective number of samples
+            float effectiveSamples = weights.x * weights.x / weights.y;
+            float sampleVariance = max(moments.y - moments.x * moments.x, 0.0) / effectiveSamples;
+            blendFaceColor(index, face, getColor(voxel, face), color, sampleVariance, BLEND_FACTOR, trackConvergence);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+// compute shader
+// Finds the first solid voxel in each random direction from every cell.
+// All cells share the same directions, so the cells are split into lines parallel
+// to a direction and every invocation walks one line backwards, carrying the
+// nearest hit along instead of casting a ray per cell.
+#version 430
+
+layout(local_size_x = 64) in;
+
+#include "common.glsl"
+#include "sweep.glsl"
+
+// NOTE: location = 0 is already taken by dbColorReadIdx in common.glsl
+
+// packed normalized vec3 directions
+layout(location = 1) uniform uint randomDirections[RANDOM_DIRECTION_COUNT];
+
+// mirrored with sweep.cpp
+// Offset of a line along a secondary axis after STEP steps along the principal axis.
+int sweepOffset(float slope, int step) {
+    return int(floor(0.5 + float(step) * slope));
+}
+
+uint packHit(ivec3 index, uint face) {
+    return cellIndex(index) * 8 + face;
+}
+
+void main() {
+    uint line = gl_GlobalInvocationID.x;
+    uint directionIndex = gl_GlobalInvocationID.y;
+    sceneIndex = gl_GlobalInvocationID.z;
+    vec3 direction = unpackSnorm4x8(randomDirections[directionIndex]).xyz;
+    vec3 absDirection = abs(direction);
+
+    // the line advances one cell per step along the principal axis a
+    // and at most one cell along the other axes b and c
+    int a = 0;
+    if (absDirection.y > absDirection[a]) a = 1;
+    if (absDirection.z > absDirection[a]) a = 2;
+    if (absDirection[a] == 0.0) {
+        // never sampled by sweep_gather.glsl
+        return;
+    }
+    int b = (a + 1) % 3;
+    int c = (a + 2) % 3;
+    int N = int(CHUNK_SIZE);
+    int stepA = direction[a] < 0.0 ? -1 : 1;
+    float slopeB = direction[b] / absDirection[a];
+    float slopeC = direction[c] / absDirection[a];
+
+    // lines starting outside the chunk enter it further along
+    int endB = sweepOffset(slopeB, N - 1);
+    int endC = sweepOffset(slopeC, N - 1);
+    int countB = N + abs(endB);
+    int countC = N + abs(endC);
+    if (line >= uint(countB * countC)) {
+        return;
+    }
+    int startB = int(line) / countC - max(endB, 0);
+    int startC = int(line) % countC - max(endC, 0);
+
+    // face entered by a step along a
+    uint faceA = uint(a) * 2 + uint(stepA < 0);
+    uint hit = SWEEP_MISS;
+    ivec3 next = ivec3(0);
+
+    for (int t = N - 1; t >= 0; t--) {
+        ivec3 cell;
+        cell[a] = stepA > 0 ? t : N - 1 - t;
+        cell[b] = startB + sweepOffset(slopeB, t);
+        cell[c] = startC + sweepOffset(slopeC, t);
+
+        if (t < N - 1) {
+            // a diagonal step passes the cells beside the line,
+            // which are closer than the next cell
+            ivec3 delta = next - cell;
+            if (delta[b] != 0 || delta[c] != 0) {
+                for (int i = 0; i < 3; i++) {
+                    int axis = (a + i) % 3;
+                    ivec3 side = cell;
+                    side[axis] += delta[axis];
+                    if (delta[axis] != 0 && !isOutOfBounds(side) && isSolid(getVoxel(side))) {
+                        hit = packHit(side, uint(axis) * 2 + uint(delta[axis] < 0));
+                        break;
+                    }
+                }
+            }
+        }
+        if (!isOutOfBounds(cell)) {
+            sweepVisibility.cells[sweepIndex(directionIndex, cell)] = hit;
+            if (isSolid(getVoxel(cell))) {
+                hit = packHit(cell, faceA);
+            }
+        }
+        next = cell;
+    }
+}
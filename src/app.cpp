@@ -1,8 +1,11 @@
 #include "app.h"
 #include "scene.h"
 #include "shader.h"
+#include "sweep.h"
 #include "util.h"
+#include <filesystem>
 #include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/packing.hpp>
 
 void glDebugCallback(GLenum, GLenum, GLuint, GLenum, GLsizei, const GLchar* message, const void*)
@@ -17,17 +20,24 @@ void setupDebugInfo()
     glDebugMessageCallback(glDebugCallback, nullptr);
 }
 
-void App::initRandomDirections()
+// Returns false and reports it if a storage buffer NAME with COUNT elements of
+// ELEMENT_SIZE bytes does not fit into a shader storage block or cannot be indexed
+// with 32 bits.
+static bool checkStorageSize(const char* name, size_t count, size_t elementSize)
 {
-    for (size_t i = 0; i < RANDOM_DIRECTION_COUNT; i++) {
-        randomDirections[i] = glm::packSnorm4x8(glm::vec4(
-            glm::normalize(glm::vec3(
-                randf_normal(),
-                randf_normal(),
-                randf_normal())),
-            // 0.0f as padding between array elements
-            0.0f));
+    GLint64 maxSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxSize);
+    if (count > 0xffffffffu || count * elementSize > (size_t)maxSize) {
+        std::cerr << "The " << name << " buffer needs " << count * elementSize << " bytes, but the driver allows "
+                  << maxSize << " bytes per storage buffer. Use a smaller --chunk-size or fewer scenes." << std::endl;
+        return false;
     }
+    return true;
+}
+
+void App::initRandomDirections()
+{
+    randomPackedDirections(randomDirections, RANDOM_DIRECTION_COUNT);
 }
 
 void App::initFullScreenQuad()
@@ -46,14 +56,80 @@ void App::initFullScreenQuad()
     glEnableVertexAttribArray(posAttr);
 }
 
-void App::initChunk()
+bool App::initChunks()
 {
-    chunk.init();
+    sceneNames = isBaking() ? options.bakeScenes : std::vector { options.scene };
+    glm::uint size = options.chunkSize;
+    size_t voxelCount = (size_t)size * size * size;
+    // the per-face buffers are the largest after the voxels
+    if (!checkStorageSize("voxel", sceneNames.size() * voxelCount, sizeof(Voxel))
+        || !checkStorageSize("denoise", sceneNames.size() * voxelCount * 6, sizeof(glm::vec4))) {
+        return false;
+    }
+    if (!voxelArena.init(sceneNames.size() * voxelCount * sizeof(Voxel)))
+        return false;
+    // the chunks are contiguous, so they are uploaded at once
+    Voxel* voxels = voxelArena.allocate<Voxel>(sceneNames.size() * voxelCount);
+    chunks = std::vector<Chunk>(sceneNames.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        SceneFunction scene = findScene(sceneNames[i]);
+        if (scene == nullptr) {
+            std::cerr << "Unknown scene " << sceneNames[i] << "." << std::endl;
+            return false;
+        }
+        chunks[i].size = size;
+        chunks[i].voxels = voxels + i * voxelCount;
+        chunks[i].init(scene);
+    }
     glGenBuffers(1, &storageBuffer);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, storageBuffer);
     assert(glIsBuffer(storageBuffer));
-    glNamedBufferStorage(storageBuffer, sizeof(chunk), chunk.voxels, 0);
+    // dynamic so that setVoxel() can update single voxels
+    glNamedBufferStorage(storageBuffer, chunks.size() * voxelCount * sizeof(Voxel), voxels, GL_DYNAMIC_STORAGE_BIT);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BUFFER_BINDING, storageBuffer);
+
+    glGenBuffers(1, &chunkInfoBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunkInfoBuffer);
+    assert(glIsBuffer(chunkInfoBuffer));
+    glNamedBufferStorage(chunkInfoBuffer, sizeof(glm::uint), &size, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CHUNK_INFO_BINDING, chunkInfoBuffer);
+
+    std::vector<SceneState> sceneStates(chunks.size(), SceneState {});
+    glGenBuffers(1, &sceneStateBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sceneStateBuffer);
+    assert(glIsBuffer(sceneStateBuffer));
+    glNamedBufferStorage(sceneStateBuffer, sceneStates.size() * sizeof(SceneState), sceneStates.data(), GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_STATE_BINDING, sceneStateBuffer);
+
+    // only the displayed scene is prioritized, the counter is cleared every frame
+    glGenBuffers(1, &priorityBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, priorityBuffer);
+    assert(glIsBuffer(priorityBuffer));
+    glNamedBufferStorage(priorityBuffer, sizeof(PriorityCounters) + voxelCount * sizeof(VoxelPriority), nullptr, 0);
+    // only matches the frame before the first one, so every voxel has a high priority in the first frame
+    const GLuint NEVER = 0xffffffffu;
+    glClearNamedBufferData(priorityBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &NEVER);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PRIORITY_BUFFER_BINDING, priorityBuffer);
+    return true;
+}
+
+void App::initDenoiseBuffers()
+{
+    glGenBuffers(1, &varianceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, varianceBuffer);
+    assert(glIsBuffer(varianceBuffer));
+    glNamedBufferStorage(varianceBuffer, chunks.size() * chunks[0].faceCount() * sizeof(GLfloat), nullptr, 0);
+    glClearNamedBufferData(varianceBuffer, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VARIANCE_BUFFER_BINDING, varianceBuffer);
+
+    glGenBuffers(2, filterBuffers);
+    for (GLuint buffer : filterBuffers) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        assert(glIsBuffer(buffer));
+        glNamedBufferStorage(buffer, chunks.size() * chunks[0].faceCount() * sizeof(glm::vec4), nullptr, 0);
+        glClearNamedBufferData(buffer, GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FILTERED_BUFFER_BINDING, filterBuffers[0]);
 }
 
 bool App::initShaders()
@@ -66,6 +142,11 @@ bool App::initShaders()
             std::cerr << "Failed to initialize OpenGL state (voxelProgram error)." << std::endl;
             return false;
         }
+        GLuint denoiseShader = loadShader(GL_COMPUTE_SHADER, "denoise.glsl");
+        if (!denoiseProgram.init({ denoiseShader }, {})) {
+            std::cerr << "Failed to initialize OpenGL state (denoiseProgram error)." << std::endl;
+            return false;
+        }
     }
     // render shaders
     {
@@ -77,14 +158,60 @@ bool App::initShaders()
             return false;
         }
     }
+    // rasterized render shaders
+    {
+        GLuint vertexShader = loadShader(GL_VERTEX_SHADER, "mesh_vert.glsl");
+        GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, "mesh_frag.glsl");
+        // attribute indices match ChunkMesher::init()
+        if (!meshProgram.init({ vertexShader, fragmentShader }, { { "inPos", 0 }, { "inFace", 1 } })) {
+            std::cerr << "Failed to initialize OpenGL state (meshProgram error)." << std::endl;
+            return false;
+        }
+        GLuint skyVertexShader = loadShader(GL_VERTEX_SHADER, "vert.glsl");
+        GLuint skyFragmentShader = loadShader(GL_FRAGMENT_SHADER, "sky_frag.glsl");
+        if (!skyProgram.init({ skyVertexShader, skyFragmentShader }, { { "inPos", 0 } })) {
+            std::cerr << "Failed to initialize OpenGL state (skyProgram error)." << std::endl;
+            return false;
+        }
+    }
     std::cout << "Finished loading shaders." << std::endl;
     return true;
 }
 
+bool App::initSweep()
+{
+    GLuint sweepShader = loadShader(GL_COMPUTE_SHADER, "sweep_visibility.glsl");
+    if (!sweepProgram.init({ sweepShader }, {})) {
+        std::cerr << "Failed to initialize OpenGL state (sweepProgram error)." << std::endl;
+        return false;
+    }
+    GLuint gatherShader = loadShader(GL_COMPUTE_SHADER, "sweep_gather.glsl");
+    if (!gatherProgram.init({ gatherShader }, {})) {
+        std::cerr << "Failed to initialize OpenGL state (gatherProgram error)." << std::endl;
+        return false;
+    }
+    size_t cellCount = chunks.size() * RANDOM_DIRECTION_COUNT * chunks[0].voxelCount();
+    if (!checkStorageSize("sweep visibility", cellCount, sizeof(glm::uint))) {
+        return false;
+    }
+    if (options.gather == GatherMode::SweepCpu) {
+        sweepData.resize(cellCount);
+    }
+    glGenBuffers(1, &sweepBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sweepBuffer);
+    assert(glIsBuffer(sweepBuffer));
+    // only written by glNamedBufferSubData() when the sweep runs on the CPU
+    GLbitfield flags = options.gather == GatherMode::SweepCpu ? GL_DYNAMIC_STORAGE_BIT : 0;
+    glNamedBufferStorage(sweepBuffer, cellCount * sizeof(glm::uint), nullptr, flags);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SWEEP_VISIBILITY_BINDING, sweepBuffer);
+    return true;
+}
+
 bool App::init(uint width, uint height)
 {
     initRandomDirections();
-    camera = Camera { glm::vec3(CHUNK_SIZE) / 2.0f, width, height };
+    this->width = width;
+    this->height = height;
 
     std::cout << "Initializing OpenGL." << std::endl;
     // TODO: error handling (with glIsBuffers for buffers)
@@ -98,9 +225,38 @@ bool App::init(uint width, uint height)
 
     setupDebugInfo();
     initFullScreenQuad();
-    initChunk();
+    if (!initChunks())
+        return false;
+    initDenoiseBuffers();
+    mesher.init(options.chunkSize);
     if (!initShaders())
         return false;
+    if (options.gather != GatherMode::Ray && !initSweep())
+        return false;
+    if (!lightQueries.init())
+        return false;
+    if (!capture.init(options.captureFormat, options.capturePath, options.captureFps))
+        return false;
+    capture.setRecording(options.captureOnStart);
+
+    if (isBaking()) {
+        std::error_code error;
+        std::filesystem::create_directories(options.bakeOutput, error);
+        if (error) {
+            std::cerr << "Failed to create bake directory " << options.bakeOutput << ": " << error.message() << std::endl;
+            return false;
+        }
+        const GLbitfield READ_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &bakeReadbackBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bakeReadbackBuffer);
+        assert(glIsBuffer(bakeReadbackBuffer));
+        glNamedBufferStorage(bakeReadbackBuffer, chunks.size() * sizeof(SceneState), nullptr, READ_FLAGS);
+        bakeReadbackData = glMapNamedBufferRange(bakeReadbackBuffer, 0, chunks.size() * sizeof(SceneState), READ_FLAGS);
+
+        bakeProgress = std::vector<BakeProgress>(chunks.size());
+        std::cout << "Baking " << chunks.size() << " scenes." << std::endl;
+        bakeStart = std::chrono::steady_clock::now();
+    }
 
     // --- shaders ---
     std::cout << "Finished initializing OpenGL state." << std::endl;
@@ -110,52 +266,390 @@ bool App::init(uint width, uint height)
 void App::resize(uint newWidth, uint newHeight)
 {
     glViewport(0, 0, newWidth, newHeight);
-    camera.resize(newWidth, newHeight);
+    width = newWidth;
+    height = newHeight;
 }
 
 void App::destroy()
 {
+    capture.destroy();
+    lightQueries.destroy();
     voxelProgram.destroy();
+    denoiseProgram.destroy();
     renderProgram.destroy();
+    meshProgram.destroy();
+    skyProgram.destroy();
+    sweepProgram.destroy();
+    gatherProgram.destroy();
+    mesher.destroy();
     if (vertexBuffer)
         glDeleteBuffers(1, &vertexBuffer);
     if (vertexArray)
         glDeleteVertexArrays(1, &vertexArray);
     if (storageBuffer)
         glDeleteBuffers(1, &storageBuffer);
+    if (chunkInfoBuffer)
+        glDeleteBuffers(1, &chunkInfoBuffer);
+    if (varianceBuffer)
+        glDeleteBuffers(1, &varianceBuffer);
+    for (GLuint buffer : filterBuffers) {
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    }
+    if (sceneStateBuffer)
+        glDeleteBuffers(1, &sceneStateBuffer);
+    if (priorityBuffer)
+        glDeleteBuffers(1, &priorityBuffer);
+    if (sweepBuffer)
+        glDeleteBuffers(1, &sweepBuffer);
+    if (bakeFence)
+        glDeleteSync(bakeFence);
+    if (bakeReadbackBuffer) {
+        glUnmapNamedBuffer(bakeReadbackBuffer);
+        glDeleteBuffers(1, &bakeReadbackBuffer);
+    }
+    chunks.clear();
+    voxelArena.destroy();
 }
 
-bool App::update(InputState& inputs, float deltaTime)
+void App::denoise()
 {
-    // recalculate random directions to reduce direction bias
-    initRandomDirections();
-    // update camera based on user input
-    camera.update(inputs, deltaTime);
+    denoiseProgram.use();
+    glUniform1ui(denoiseProgram.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
 
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
+    for (uint i = 0; i < options.denoiseIterations; i++) {
+        // iteration i writes to filterBuffers[i % 2] and reads the output of the previous one
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FILTER_INPUT_BINDING, filterBuffers[(i + 1) % 2]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FILTER_OUTPUT_BINDING, filterBuffers[i % 2]);
+        glUniform1ui(denoiseProgram.getUniformLocation("iteration"), i);
+        dispatchVoxels();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, FILTERED_BUFFER_BINDING, filterBuffers[(options.denoiseIterations - 1) % 2]);
+}
 
-    {
-        voxelProgram.use();
-        glUniform1ui(voxelProgram.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
-        glUniform1ui(voxelProgram.getUniformLocation("frameNumber"), frameNumber);
-        glUniform1uiv(voxelProgram.getUniformLocation("randomDirections"), RANDOM_DIRECTION_COUNT, randomDirections);
-        glDispatchCompute(WORKGROUP_SIZE.x, WORKGROUP_SIZE.y, WORKGROUP_SIZE.z);
+void App::queryLight(glm::vec3 point, LightCallback callback)
+{
+    lightQueries.queryPoint(point, std::move(callback));
+}
+
+void App::queryLight(glm::ivec3 index, glm::uint face, LightCallback callback)
+{
+    lightQueries.queryFace(index, face, std::move(callback));
+}
+
+LightResult App::queryLight(glm::vec3 point)
+{
+    return lightQueries.queryPoint(point);
+}
+
+LightResult App::queryLight(glm::ivec3 index, glm::uint face)
+{
+    return lightQueries.queryFace(index, face);
+}
+
+void App::setVoxel(glm::ivec3 index, Voxel voxel)
+{
+    if (!chunks[0].isInBounds(index)) {
+        return;
+    }
+    // the displayed scene is the first one in storageBuffer
+    Voxel& target = chunks[0].at(index);
+    target = voxel;
+    glNamedBufferSubData(storageBuffer, chunks[0].cellIndex(index) * sizeof(Voxel), sizeof(Voxel), &target);
+    mesher.markDirty(index);
+}
+
+void App::renderRayCast(const FrameState& frame)
+{
+    renderProgram.use();
+    glBindVertexArray(vertexArray);
+    glUniform1ui(renderProgram.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
+    glUniform3fv(renderProgram.getUniformLocation("position"), 1, glm::value_ptr(frame.cameraPosition));
+    glUniformMatrix3fv(renderProgram.getUniformLocation("rotation"), 1, true, glm::value_ptr(glm::inverse(frame.cameraRotation)));
+    glUniform1f(renderProgram.getUniformLocation("aspectRatio"), frame.aspectRatio);
+    glUniform1i(renderProgram.getUniformLocation("useFiltered"), options.denoiseIterations > 0);
+    glUniform1ui(renderProgram.getUniformLocation("frameNumber"), frameNumber);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void App::renderRaster(const FrameState& frame)
+{
+    // only rebuilds the bricks changed by setVoxel()
+    mesher.update(chunks[0]);
+
+    // background
+    skyProgram.use();
+    glBindVertexArray(vertexArray);
+    glUniformMatrix3fv(skyProgram.getUniformLocation("rotation"), 1, true, glm::value_ptr(glm::inverse(frame.cameraRotation)));
+    glUniform1f(skyProgram.getUniformLocation("aspectRatio"), frame.aspectRatio);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    // matches the 90 degree vertical field of view of the ray cast in frag.glsl
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), frame.aspectRatio, 0.01f, 2.0f * options.chunkSize);
+    glm::mat4 view = glm::mat4(glm::transpose(frame.cameraRotation))
+        * glm::translate(glm::mat4(1.0f), -frame.cameraPosition);
+    glm::mat4 viewProjection = projection * view;
+
+    glEnable(GL_DEPTH_TEST);
+    meshProgram.use();
+    glUniform1ui(meshProgram.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
+    glUniformMatrix4fv(meshProgram.getUniformLocation("viewProjection"), 1, false, glm::value_ptr(viewProjection));
+    glUniform1i(meshProgram.getUniformLocation("useFiltered"), options.denoiseIterations > 0);
+    glUniform1ui(meshProgram.getUniformLocation("frameNumber"), frameNumber);
+    mesher.draw();
+    glDisable(GL_DEPTH_TEST);
+}
+
+void App::dispatchVoxels()
+{
+    glm::uint groups = options.chunkSize / VOXEL_WORKGROUP_SIZE;
+    // scenes are stacked along z
+    glDispatchCompute(groups, groups, groups * chunks.size());
+}
+
+void App::sweepDirections()
+{
+    if (options.gather == GatherMode::SweepCpu) {
+        // every task writes the visibility of one scene in one direction
+        parallelFor(chunks.size() * RANDOM_DIRECTION_COUNT, [&](size_t i) {
+            size_t scene = i / RANDOM_DIRECTION_COUNT;
+            if (isBaking() && bakeProgress[scene].done) {
+                return;
+            }
+            glm::vec3 direction = glm::vec3(glm::unpackSnorm4x8(randomDirections[i % RANDOM_DIRECTION_COUNT]));
+            sweepVisibility(chunks[scene], direction, &sweepData[i * chunks[scene].voxelCount()]);
+        });
+        glNamedBufferSubData(sweepBuffer, 0, sweepData.size() * sizeof(glm::uint), sweepData.data());
+        return;
     }
+    sweepProgram.use();
+    glUniform1uiv(sweepProgram.getUniformLocation("randomDirections"), RANDOM_DIRECTION_COUNT, randomDirections);
+    // one invocation per line, one direction per y and one scene per z
+    glDispatchCompute(sweepMaxLines(options.chunkSize) / SWEEP_WORKGROUP_SIZE, RANDOM_DIRECTION_COUNT, chunks.size());
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void App::updateLight(bool trackConvergence)
+{
+    // both programs take the same uniforms and run per voxel
+    ShaderProgram& program = options.gather == GatherMode::Ray ? voxelProgram : gatherProgram;
+    if (options.gather != GatherMode::Ray) {
+        sweepDirections();
+    }
+    program.use();
+    glUniform1ui(program.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
+    glUniform1ui(program.getUniformLocation("frameNumber"), frameNumber);
+    glUniform1uiv(program.getUniformLocation("randomDirections"), RANDOM_DIRECTION_COUNT, randomDirections);
+    glUniform1i(program.getUniformLocation("useFilteredFeedback"), options.denoiseFeedback);
+    glUniform1i(program.getUniformLocation("trackConvergence"), trackConvergence);
+    glUniform1ui(program.getUniformLocation("priorityInterval"), options.priorityInterval);
+    glUniform1ui(program.getUniformLocation("rayBudget"), options.rayBudget);
+    glUniform1i(program.getUniformLocation("checkSchedule"), options.checkSchedule);
+
+    // nothing is in view while baking
+    bool prioritize = !isBaking() && (options.priorityInterval > 1 || options.rayBudget > 0);
+    if (prioritize) {
+        glClearNamedBufferSubData(priorityBuffer, GL_R32UI, 0, sizeof(PriorityCounters), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        // the voxels in view use up the ray budget first
+        glUniform1ui(program.getUniformLocation("updatePass"), UPDATE_HIGH_PRIORITY);
+        dispatchVoxels();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glUniform1ui(program.getUniformLocation("updatePass"), UPDATE_LOW_PRIORITY);
+    } else {
+        glUniform1ui(program.getUniformLocation("updatePass"), UPDATE_ALL);
+    }
+    dispatchVoxels();
+    if (prioritize && options.checkSchedule) {
+        checkSchedule();
+    }
+
     // swap double buffers
     // done before rendering so that the written data from this frame's chunk update is read
     dbColorReadIdx = 1 - dbColorReadIdx;
 
-    // ensure voxel chunk update happens before rendering
+    // ensure voxel chunk update happens before denoising and rendering
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    {
-        renderProgram.use();
-        glUniform1ui(renderProgram.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
-        glUniform3fv(renderProgram.getUniformLocation("position"), 1, glm::value_ptr(camera.getPosition()));
-        glUniformMatrix3fv(renderProgram.getUniformLocation("rotation"), 1, true, glm::value_ptr(glm::inverse(camera.getRotation())));
-        glUniform1f(renderProgram.getUniformLocation("aspectRatio"), camera.getAspectRatio());
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void App::checkSchedule()
+{
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    PriorityCounters counters;
+    glGetNamedBufferSubData(priorityBuffer, 0, sizeof(counters), &counters);
+    // every solid voxel goes through one of the passes
+    size_t solid = chunks[0].countSolid();
+    if (counters.handled != solid || counters.duplicates != 0) {
+        std::cerr << "Frame " << frameNumber << ": the light update handled " << counters.handled << " of "
+                  << solid << " voxels, " << counters.duplicates << " of them more than once." << std::endl;
+    }
+}
+
+void App::applyEdits(EditQueue& edits)
+{
+    VoxelEdit edit;
+    while (edits.pop(edit)) {
+        setVoxel(edit.index, edit.voxel);
+    }
+}
+
+bool App::update(const FrameState& frame)
+{
+    // recalculate random directions to reduce direction bias
+    initRandomDirections();
+    if (isBaking()) {
+        return updateBake();
+    }
+    if (frame.width != width || frame.height != height) {
+        resize(frame.width, frame.height);
+    }
+    capture.setRecording(frame.capturing);
+
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    updateLight(false);
+    if (options.denoiseIterations > 0) {
+        denoise();
     }
+    // answers the light queries of this frame and delivers older results
+    lightQueries.update(dbColorReadIdx, options.denoiseIterations > 0);
+    if (frame.raster) {
+        renderRaster(frame);
+    } else {
+        renderRayCast(frame);
+    }
+    // the voxels marked as seen prioritize the next light update
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    // read back the finished frame before it is swapped
+    capture.capture(width, height);
     frameNumber += 1;
     return true;
 }
+
+bool App::isBaking()
+{
+    return !options.bakeScenes.empty();
+}
+
+bool App::updateBake()
+{
+    // nothing is rendered while baking
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    bool check = bakeFence == nullptr && frameNumber % BAKE_CHECK_INTERVAL == 0;
+    if (check) {
+        // reset the sums of the scenes and stop the ones that are done
+        std::vector<SceneState> sceneStates(chunks.size(), SceneState {});
+        for (size_t i = 0; i < chunks.size(); i++) {
+            sceneStates[i].converged = bakeProgress[i].done;
+        }
+        glNamedBufferSubData(sceneStateBuffer, 0, sceneStates.size() * sizeof(SceneState), sceneStates.data());
+    }
+
+    updateLight(check);
+    // the denoised colors are only needed when light bounces off them
+    if (options.denoiseFeedback) {
+        denoise();
+    }
+
+    if (check) {
+        // copy the sums without waiting, they are read once the fence has signaled
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glCopyNamedBufferSubData(sceneStateBuffer, bakeReadbackBuffer, 0, 0, chunks.size() * sizeof(SceneState));
+        bakeFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        bakeCheckFrame = frameNumber;
+    }
+    frameNumber += 1;
+    checkBakeConvergence();
+
+    for (auto& progress : bakeProgress) {
+        if (!progress.done)
+            return true;
+    }
+    finishBake();
+    return false;
+}
+
+void App::checkBakeConvergence()
+{
+    if (bakeFence == nullptr) {
+        return;
+    }
+    GLenum status = glClientWaitSync(bakeFence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+        return;
+    }
+    glDeleteSync(bakeFence);
+    bakeFence = nullptr;
+
+    const SceneState* sceneStates = (const SceneState*)bakeReadbackData;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bakeStart).count();
+    for (size_t i = 0; i < chunks.size(); i++) {
+        BakeProgress& progress = bakeProgress[i];
+        if (progress.done) {
+            continue;
+        }
+        double change = sceneStates[i].getChange();
+        double luminance = sceneStates[i].getLuminance();
+        if (luminance > 0.0) {
+            progress.relativeChange = change / luminance;
+        } else {
+            // no light has arrived yet, or never will
+            progress.relativeChange = change > 0.0 ? 1.0 : 0.0;
+        }
+        progress.frames = bakeCheckFrame + 1;
+        bool converged = progress.frames >= BAKE_MIN_FRAMES && progress.relativeChange < options.bakeThreshold;
+        if (converged || progress.frames >= options.bakeMaxFrames) {
+            progress.done = true;
+            progress.seconds = seconds;
+            writeBakeOutput(i);
+            std::cout << "Baked scene " << i << " (" << sceneNames[i] << ") in " << progress.frames << " frames, "
+                      << progress.seconds << " s" << (converged ? "." : " without converging.") << std::endl;
+        }
+    }
+}
+
+void App::writeBakeOutput(size_t scene)
+{
+    // waits for the GPU, but only once per scene
+    const Chunk& chunk = chunks[scene];
+    glGetNamedBufferSubData(storageBuffer, scene * chunk.voxelCount() * sizeof(Voxel), chunk.voxelCount() * sizeof(Voxel), chunk.voxels);
+
+    std::ostringstream name;
+    name << options.bakeOutput << "/" << scene << "_" << sceneNames[scene] << ".bin";
+    std::ofstream file(name.str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << name.str() << " for writing." << std::endl;
+        return;
+    }
+    // rgb float color per face, for voxels in [x][y][z] order
+    std::vector<glm::vec3> colors;
+    colors.reserve(chunk.faceCount());
+    for (size_t i = 0; i < chunk.voxelCount(); i++) {
+        for (uint32_t face = 0; face < 6; face++) {
+            colors.push_back(chunk.voxels[i].dbFaceColor[face][dbColorReadIdx].color);
+        }
+    }
+    file.write((const char*)colors.data(), colors.size() * sizeof(glm::vec3));
+}
+
+void App::finishBake()
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bakeStart).count();
+    std::string summaryName = options.bakeOutput + "/bake.csv";
+    std::ofstream summary(summaryName);
+    if (summary.is_open()) {
+        summary << "scene,name,frames,seconds,relative_change\n";
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const BakeProgress& progress = bakeProgress[i];
+            summary << i << ',' << sceneNames[i] << ',' << progress.frames << ','
+                    << progress.seconds << ',' << progress.relativeChange << '\n';
+        }
+    } else {
+        std::cerr << "Failed to open " << summaryName << " for writing." << std::endl;
+    }
+    std::cout << "Baked " << chunks.size() << " scenes in " << seconds << " s ("
+              << chunks.size() * 3600.0 / seconds << " scenes per hour)." << std::endl;
+}
@@ -1,16 +1,40 @@
 #pragma once
 
-#include "camera.h"
+#include "arena.h"
+#include "capture.h"
+#include "light_query.h"
+#include "mesher.h"
+#include "options.h"
 #include "scene.h"
 #include "shader.h"
+#include "simulation.h"
+#include <chrono>
+#include <string>
+#include <vector>
 
-// mirrored in light_update.glsl
-// NOTE: 512+ causes shader compilation fail
-const glm::uint RANDOM_DIRECTION_COUNT = 16;
+const GLfloat QUAD_VERTICES[] = {
+    -1.0, -1.0,
+    1.0, -1.0,
+    -1.0, 1.0,
+    -1.0, 1.0,
+    1.0, 1.0,
+    1.0, -1.0
+};
+
+// mirrored in common.glsl
+// the voxels that a light update pass updates
+const glm::uint UPDATE_ALL = 0;
+const glm::uint UPDATE_HIGH_PRIORITY = 1;
+const glm::uint UPDATE_LOW_PRIORITY = 2;
+// frames between convergence checks while baking
+const glm::uint BAKE_CHECK_INTERVAL = 16;
+// scenes are not considered converged before this many frames
+const glm::uint BAKE_MIN_FRAMES = 64;
 
 class App {
 public:
-    App()
+    App(const Options& options)
+        : options { options }
     {
     }
 
@@ -18,29 +42,124 @@ public:
     bool init(uint width, uint height);
     // Resize the viewport.
     void resize(uint newWidth, uint newHeight);
-    bool update(InputState& inputs, float deltaTime);
+    // Renders FRAME, the latest state published by the simulation.
+    // Returns false once the app should exit.
+    bool update(const FrameState& frame);
     void destroy();
 
+    // Replaces the voxel at INDEX on both the CPU and the GPU.
+    void setVoxel(glm::ivec3 index, Voxel voxel);
+    // Applies the voxel edits queued by the simulation.
+    void applyEdits(EditQueue& edits);
+
+    // The functions above and the light queries below use OpenGL,
+    // so they must be called on the thread that owns the context.
+
+    // Queues a query for the light level at POINT in voxel coordinates.
+    // The result is passed to CALLBACK during update() one or two frames later.
+    void queryLight(glm::vec3 point, LightCallback callback);
+    // Queues a query for the color of FACE of the voxel at INDEX.
+    void queryLight(glm::ivec3 index, glm::uint face, LightCallback callback);
+    // Same as above, but the result is polled through the returned LightResult.
+    // It never becomes ready while this thread waits for it.
+    LightResult queryLight(glm::vec3 point);
+    LightResult queryLight(glm::ivec3 index, glm::uint face);
+
 private:
     void initRandomDirections();
     // Initializes the vertex buffer with a full-screen quad.
     void initFullScreenQuad();
-    // Initializes the chunk and associated buffer.
-    void initChunk();
+    // Initializes the chunks of all scenes and the associated buffers.
+    bool initChunks();
+    // Initializes the per-face variance and denoise buffers.
+    void initDenoiseBuffers();
     // Loads shaders and creates the shader programs.
     bool initShaders();
+    // Creates the visibility buffer and the shaders of the sweep gather modes.
+    bool initSweep();
+    // Runs the light update compute shader on all scenes and swaps the color double-buffers.
+    // Voxels in view are updated before the others when prioritizing.
+    // Sums the luminance change of each scene into sceneStateBuffer if TRACK_CONVERGENCE is set.
+    void updateLight(bool trackConvergence);
+    // Reports the voxels that the prioritized light update did not handle exactly once.
+    void checkSchedule();
+    // Finds the visibility in each random direction for the sweep gather modes.
+    void sweepDirections();
+    // Filters the colors written by the light update and binds the result to FILTERED_BUFFER_BINDING.
+    void denoise();
+    // Draws the frame by casting a ray per pixel.
+    void renderRayCast(const FrameState& frame);
+    // Draws the frame by rasterizing the greedy meshes of the chunk.
+    void renderRaster(const FrameState& frame);
+    // Runs the bound per-voxel compute program on every voxel of all scenes.
+    void dispatchVoxels();
+
+    bool isBaking();
+    // Updates all scenes without rendering and writes out the ones that have converged.
+    // Returns false once every scene has been written.
+    bool updateBake();
+    // Reads the results of the last convergence check if they are available.
+    void checkBakeConvergence();
+    // Writes the face colors of scene SCENE to the bake output directory.
+    void writeBakeOutput(size_t scene);
+    // Writes the bake summary and reports the throughput.
+    void finishBake();
 
-    Chunk chunk;
-    Camera camera { glm::vec3(CHUNK_SIZE) / 2.0f, 800, 600 };
+    Options options;
+    // the voxels of all chunks, one after the other
+    Arena voxelArena;
+    // one chunk per scene, the first one is displayed
+    std::vector<Chunk> chunks;
+    std::vector<std::string> sceneNames;
     // NOTE: uses vec4 instead of vec3 to ensure 16-byte alignment
     // which is what vec3[] uses in a shader
     glm::uint randomDirections[RANDOM_DIRECTION_COUNT];
 
+    // current window width, height
+    uint width = 800;
+    uint height = 600;
+    FrameCapture capture;
+    LightQueries lightQueries;
+    ChunkMesher mesher;
+
     ShaderProgram voxelProgram;
+    ShaderProgram denoiseProgram;
     ShaderProgram renderProgram;
+    ShaderProgram meshProgram;
+    ShaderProgram skyProgram;
+    ShaderProgram sweepProgram;
+    ShaderProgram gatherProgram;
     GLuint vertexBuffer = 0;
     GLuint vertexArray = 0;
     GLuint storageBuffer = 0;
+    // the chunk size, read by the shaders
+    GLuint chunkInfoBuffer = 0;
+    GLuint varianceBuffer = 0;
+    // ping-pong buffers of the denoise iterations
+    GLuint filterBuffers[2] = { 0, 0 };
+    // SceneState per scene
+    GLuint sceneStateBuffer = 0;
+    // PriorityCounters followed by a VoxelPriority per voxel of the displayed scene
+    GLuint priorityBuffer = 0;
+    // visibility per scene, random direction and cell, see sweep.h
+    GLuint sweepBuffer = 0;
+    // the visibility computed on the CPU before it is uploaded to sweepBuffer
+    std::vector<glm::uint> sweepData;
+
+    struct BakeProgress {
+        bool done = false;
+        glm::uint frames = 0;
+        double seconds = 0.0;
+        double relativeChange = 0.0;
+    };
+    std::vector<BakeProgress> bakeProgress;
+    std::chrono::steady_clock::time_point bakeStart;
+    // persistently mapped copy of sceneStateBuffer for convergence checks
+    GLuint bakeReadbackBuffer = 0;
+    void* bakeReadbackData = nullptr;
+    // set while a convergence check is in flight
+    GLsync bakeFence = nullptr;
+    GLuint bakeCheckFrame = 0;
     // The index of the color double-buffer.
     GLuint dbColorReadIdx = 0;
     // The number of frames since the start.
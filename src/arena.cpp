@@ -0,0 +1,56 @@
+#include "arena.h"
+#include <cstdint>
+#include <iostream>
+#include <sys/mman.h>
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool Arena::init(size_t capacity)
+{
+    destroy();
+    // whole huge pages, plus one to align the start
+    size_t size = alignUp(capacity, HUGE_PAGE_SIZE);
+    mappingSize = size + HUGE_PAGE_SIZE;
+    // only reserves address space, the pages are committed when first touched
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        mappingSize = 0;
+        std::cerr << "Failed to reserve " << capacity << " bytes for the arena." << std::endl;
+        return false;
+    }
+    memory = (char*)alignUp((uintptr_t)mapping, HUGE_PAGE_SIZE);
+#ifdef MADV_HUGEPAGE
+    // only a hint, the kernel falls back to normal pages if transparent huge pages are disabled
+    if (madvise(memory, size, MADV_HUGEPAGE) != 0) {
+        std::cout << "Transparent huge pages are not available for the arena." << std::endl;
+    }
+#endif
+    this->capacity = capacity;
+    used = 0;
+    return true;
+}
+
+void Arena::destroy()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    memory = nullptr;
+    capacity = 0;
+    used = 0;
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    size_t start = alignUp(used, alignment);
+    if (memory == nullptr || start + size > capacity) {
+        return nullptr;
+    }
+    used = start + size;
+    return memory + start;
+}
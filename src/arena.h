@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+
+// size of a transparent huge page on x86-64, the alignment of the arena
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// A region of memory for large allocations that live as long as the app, such
+// as the voxels of the chunks.
+//
+// The region is backed by transparent huge pages where the kernel allows it,
+// which cuts the TLB misses of walking a large chunk. Pages are only committed
+// when first touched, so filling the memory on several threads also spreads the
+// page faults across them. Allocations are not freed individually, destroy()
+// releases all of them.
+class Arena {
+public:
+    Arena()
+    {
+    }
+    ~Arena()
+    {
+        destroy();
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Reserves CAPACITY bytes. Returns false if the memory could not be reserved.
+    bool init(size_t capacity);
+    // Releases the memory of all allocations.
+    void destroy();
+
+    // Returns SIZE uninitialized bytes aligned to ALIGNMENT,
+    // or nullptr if the arena has no room left.
+    void* allocate(size_t size, size_t alignment);
+
+    // Returns uninitialized memory for COUNT values of type T, or nullptr.
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+private:
+    // the whole mapping, which starts before memory so that memory can be aligned
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    char* memory = nullptr;
+    size_t capacity = 0;
+    // bytes handed out so far, including the padding for alignment
+    size_t used = 0;
+};
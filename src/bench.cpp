@@ -0,0 +1,425 @@
+// Microbenchmarks of the CPU-side hot paths and of a CPU port of the ray traversal.
+//
+// Prints the results as a JSON object with one entry per benchmark. Build with
+// -DCMAKE_BUILD_TYPE=Release, since unoptimized timings say little.
+//
+// bench/baseline.json holds the results of a release build at the default chunk
+// size. Timings only compare on the same machine, so refresh the baseline there
+// before relying on it. From the repository root:
+//     cmake -S src -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build
+//     build/bench --out bench/baseline.json
+// and check for regressions against it with
+//     build/bench --compare bench/baseline.json
+// which fails if a benchmark got slower than the tolerance allows.
+
+#include "arena.h"
+#include "options.h"
+#include "scene.h"
+#include "shader_source.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// rays per ray cast batch
+const size_t RAY_COUNT = 1 << 14;
+// every benchmark runs for at least this long
+const double MIN_SECONDS = 0.25;
+#ifdef NDEBUG
+const std::string BUILD_TYPE = "release";
+#else
+const std::string BUILD_TYPE = "debug";
+#endif
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    // mean time per call
+    double nsPerOp = 0.0;
+    // mean number of DDA steps per ray, only for the ray casts
+    double stepsPerOp = 0.0;
+};
+
+// The benchmarks to run and their results.
+struct Benchmarks {
+    // only benchmarks whose name contains this are run
+    std::string filter;
+    std::vector<Result> results;
+
+    bool wants(const std::string& name) const
+    {
+        return name.find(filter) != std::string::npos;
+    }
+};
+
+// Keeps the compiler from removing work whose result is unused.
+static volatile size_t sink = 0;
+
+// Calls FUNCTION in growing batches until MIN_SECONDS have passed.
+// Returns the number of calls and the mean time per call in nanoseconds.
+template <typename Function>
+static std::pair<size_t, double> measure(Function function)
+{
+    using Clock = std::chrono::steady_clock;
+    // warms up the caches and the allocator
+    function();
+
+    size_t iterations = 0;
+    size_t batch = 1;
+    Clock::duration elapsed {};
+    while (std::chrono::duration<double>(elapsed).count() < MIN_SECONDS) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < batch; i++) {
+            function();
+        }
+        elapsed += Clock::now() - start;
+        iterations += batch;
+        batch *= 2;
+    }
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    return { iterations, ns / iterations };
+}
+
+struct RayCast {
+    bool hit;
+    glm::ivec3 voxelIndex;
+    glm::uint face;
+    // number of voxels visited
+    glm::uint steps;
+};
+
+// mirrored with rayCast() in common.glsl
+static RayCast rayCast(const Chunk& chunk, glm::vec3 origin, glm::vec3 direction)
+{
+    glm::vec3 invDirection = glm::vec3(
+        direction.x == 0.0f ? 1e30f : 1.0f / direction.x,
+        direction.y == 0.0f ? 1e30f : 1.0f / direction.y,
+        direction.z == 0.0f ? 1e30f : 1.0f / direction.z);
+
+    glm::vec3 position = glm::floor(origin);
+    glm::vec3 step = glm::sign(direction);
+    glm::vec3 delta = glm::abs(invDirection);
+    // relative boundary of the next voxel
+    glm::vec3 boundary = glm::max(step, glm::vec3(0.0f));
+    glm::vec3 t = (boundary - glm::fract(origin)) * invDirection;
+    // dimension along which the last step was taken
+    int dim = 0;
+    glm::uint steps = 0;
+
+    while (true) {
+        glm::ivec3 index = glm::ivec3(glm::floor(position));
+        steps += 1;
+        if (!chunk.isInBounds(index)) {
+            return RayCast { false, glm::ivec3(0), 0, steps };
+        }
+        if (chunk.isSolid(index)) {
+            glm::uint face = dim * 2 + (step[dim] < 0.0f ? 1 : 0);
+            return RayCast { true, index, face, steps };
+        }
+
+        dim = 2;
+        if (t.x < t.y) {
+            if (t.x < t.z)
+                dim = 0;
+        } else {
+            if (t.y < t.z)
+                dim = 1;
+        }
+        position[dim] += step[dim];
+        t[dim] += delta[dim];
+    }
+}
+
+static void benchChunkInit(Benchmarks& bench, Chunk& chunk)
+{
+    for (auto& scene : SCENES) {
+        std::string name = std::string("chunk_init/") + scene.first;
+        if (!bench.wants(name))
+            continue;
+        auto [iterations, ns] = measure([&]() { chunk.init(scene.second); });
+        bench.results.push_back(Result { name, iterations, ns });
+    }
+}
+
+static void benchRandomDirections(Benchmarks& bench)
+{
+    if (!bench.wants("random_directions"))
+        return;
+    glm::uint directions[RANDOM_DIRECTION_COUNT];
+    auto [iterations, ns] = measure([&]() {
+        randomPackedDirections(directions, RANDOM_DIRECTION_COUNT);
+        sink = sink + directions[0];
+    });
+    bench.results.push_back(Result { "random_directions", iterations, ns });
+}
+
+static bool benchShaders(Benchmarks& bench)
+{
+    std::vector<std::string> names;
+    for (auto& entry : std::filesystem::directory_iterator(std::string(PROJECT_ROOT) + "/shaders/")) {
+        if (entry.path().extension() == ".glsl") {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    for (auto& name : names) {
+        std::string raw;
+        std::string source;
+        if (!readShader(name, raw) || !addIncludes(raw, source)) {
+            return false;
+        }
+        if (bench.wants("add_includes/" + name)) {
+            auto [iterations, ns] = measure([&]() {
+                addIncludes(raw, source);
+                sink = sink + source.size();
+            });
+            bench.results.push_back(Result { "add_includes/" + name, iterations, ns });
+        }
+        // also reads the files, like loadShader() does
+        if (bench.wants("preprocess_shader/" + name)) {
+            auto [iterations, ns] = measure([&]() {
+                preprocessShader(name, source);
+                sink = sink + source.size();
+            });
+            bench.results.push_back(Result { "preprocess_shader/" + name, iterations, ns });
+        }
+    }
+    return true;
+}
+
+static void benchRayCast(Benchmarks& bench, Chunk& chunk)
+{
+    std::vector<glm::vec3> origins(RAY_COUNT);
+    std::vector<glm::vec3> directions(RAY_COUNT);
+
+    for (auto& scene : SCENES) {
+        std::string name = std::string("ray_cast/") + scene.first;
+        if (!bench.wants(name))
+            continue;
+        // the same rays regardless of which benchmarks ran before
+        seedRandom(0);
+        chunk.init(scene.second);
+        // rays start in the air like the camera rays and most light update rays do
+        for (size_t i = 0; i < RAY_COUNT; i++) {
+            glm::vec3 origin = glm::vec3(randf(), randf(), randf()) * (float)chunk.size;
+            for (int tries = 0; tries < 100 && chunk.isSolid(glm::ivec3(origin)); tries++) {
+                origin = glm::vec3(randf(), randf(), randf()) * (float)chunk.size;
+            }
+            origins[i] = origin;
+            directions[i] = glm::normalize(glm::vec3(randf_normal(), randf_normal(), randf_normal()));
+        }
+
+        size_t steps = 0;
+        for (size_t i = 0; i < RAY_COUNT; i++) {
+            steps += rayCast(chunk, origins[i], directions[i]).steps;
+        }
+        auto [iterations, ns] = measure([&]() {
+            size_t hits = 0;
+            for (size_t i = 0; i < RAY_COUNT; i++) {
+                hits += rayCast(chunk, origins[i], directions[i]).hit;
+            }
+            sink = sink + hits;
+        });
+        bench.results.push_back(Result {
+            name,
+            iterations * RAY_COUNT,
+            ns / RAY_COUNT,
+            (double)steps / RAY_COUNT,
+        });
+    }
+}
+
+static void writeJson(const std::vector<Result>& results, glm::uint chunkSize, std::ostream& out)
+{
+    out << "{\n"
+        << "  \"chunk_size\": " << chunkSize << ",\n"
+        << "  \"build\": \"" << BUILD_TYPE << "\",\n"
+        << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.nsPerOp;
+        if (result.stepsPerOp > 0.0) {
+            out << ", \"steps_per_op\": " << result.stepsPerOp;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n"
+        << "}" << std::endl;
+}
+
+struct Baseline {
+    glm::uint chunkSize = 0;
+    std::string build;
+    // time per call by benchmark name
+    std::map<std::string, double> nsPerOp;
+};
+
+// Reads a file written by writeJson().
+static bool readBaseline(const std::string& path, Baseline& baseline)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open baseline " << path << "." << std::endl;
+        return false;
+    }
+    const std::string CHUNK_SIZE_KEY = "\"chunk_size\": ";
+    const std::string BUILD_KEY = "\"build\": \"";
+    const std::string NAME_KEY = "\"name\": \"";
+    const std::string TIME_KEY = "\"ns_per_op\": ";
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t chunkSize = line.find(CHUNK_SIZE_KEY);
+        if (chunkSize != std::string::npos) {
+            baseline.chunkSize = std::strtoul(line.c_str() + chunkSize + CHUNK_SIZE_KEY.size(), nullptr, 10);
+            continue;
+        }
+        size_t build = line.find(BUILD_KEY);
+        if (build != std::string::npos) {
+            build += BUILD_KEY.size();
+            baseline.build = line.substr(build, line.find('"', build) - build);
+            continue;
+        }
+        size_t name = line.find(NAME_KEY);
+        size_t time = line.find(TIME_KEY);
+        if (name == std::string::npos || time == std::string::npos) {
+            continue;
+        }
+        name += NAME_KEY.size();
+        baseline.nsPerOp[line.substr(name, line.find('"', name) - name)] = std::strtod(line.c_str() + time + TIME_KEY.size(), nullptr);
+    }
+    return true;
+}
+
+// Prints the change of each benchmark relative to BASELINE.
+// Returns false if any got slower by more than TOLERANCE,
+// or if the baseline was recorded with a different chunk size or build type.
+static bool compare(const std::vector<Result>& results, glm::uint chunkSize, const Baseline& baseline, double tolerance)
+{
+    if (baseline.chunkSize != chunkSize) {
+        std::cerr << "The baseline was recorded with chunk size " << baseline.chunkSize
+                  << ", run with --chunk-size " << baseline.chunkSize << " to compare against it." << std::endl;
+        return false;
+    }
+    if (baseline.build != BUILD_TYPE) {
+        std::cerr << "The baseline was recorded with a " << baseline.build << " build, this is a " << BUILD_TYPE << " build." << std::endl;
+        return false;
+    }
+    bool passed = true;
+    for (auto& result : results) {
+        auto it = baseline.nsPerOp.find(result.name);
+        if (it == baseline.nsPerOp.end() || it->second <= 0.0) {
+            std::cerr << result.name << ": no baseline" << std::endl;
+            continue;
+        }
+        double ratio = result.nsPerOp / it->second;
+        bool regressed = ratio > 1.0 + tolerance;
+        std::cerr << result.name << ": " << (ratio - 1.0) * 100.0 << "%" << (regressed ? " REGRESSED" : "") << std::endl;
+        passed = passed && !regressed;
+    }
+    return passed;
+}
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --out FILE          write the results to FILE instead of stdout\n"
+              << "  --filter TEXT       only run the benchmarks whose name contains TEXT\n"
+              << "  --compare FILE      compare the results against the baseline in FILE\n"
+              << "  --tolerance F       fraction by which a benchmark may get slower (default 0.1)\n"
+              << "  --chunk-size N      size of the chunks in one dimension (default 32)\n"
+              << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string outPath;
+    std::string filter;
+    std::string baselinePath;
+    double tolerance = 0.1;
+    glm::uint chunkSize = Options {}.chunkSize;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+            printUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--out") {
+            outPath = value;
+        } else if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--compare") {
+            baselinePath = value;
+        } else if (arg == "--tolerance") {
+            char* end = nullptr;
+            tolerance = std::strtod(value.c_str(), &end);
+            if (*end != '\0' || !(tolerance >= 0.0)) {
+                std::cerr << "Invalid tolerance \"" << value << "\"." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--chunk-size") {
+            char* end = nullptr;
+            unsigned long size = std::strtoul(value.c_str(), &end, 10);
+            // checked before narrowing
+            if (value[0] == '-' || *end != '\0' || size == 0 || size > MAX_CHUNK_SIZE) {
+                std::cerr << "Invalid chunk size \"" << value << "\"." << std::endl;
+                return 1;
+            }
+            chunkSize = size;
+        } else {
+            std::cerr << "Unknown argument " << arg << "." << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+#ifndef NDEBUG
+    std::cerr << "Warning: benchmarking an unoptimized build." << std::endl;
+#endif
+    // the same scenes on every run
+    seedRandom(0);
+
+    // allocated like the chunks of the app
+    Arena arena;
+    if (!arena.init((size_t)chunkSize * chunkSize * chunkSize * sizeof(Voxel))) {
+        return 1;
+    }
+    Chunk chunk;
+    chunk.size = chunkSize;
+    chunk.voxels = arena.allocate<Voxel>(chunk.voxelCount());
+
+    Benchmarks bench { filter };
+    benchChunkInit(bench, chunk);
+    benchRandomDirections(bench);
+    if (!benchShaders(bench)) {
+        return 1;
+    }
+    benchRayCast(bench, chunk);
+    const std::vector<Result>& results = bench.results;
+
+    if (outPath.empty()) {
+        writeJson(results, chunkSize, std::cout);
+    } else {
+        std::ofstream out(outPath);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open " << outPath << "." << std::endl;
+            return 1;
+        }
+        writeJson(results, chunkSize, out);
+    }
+    if (!baselinePath.empty()) {
+        Baseline baseline;
+        if (!readBaseline(baselinePath, baseline) || !compare(results, chunkSize, baseline, tolerance)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -8,7 +8,7 @@ void Camera::resize(uint newWidth, uint newHeight)
     height = newHeight;
 }
 
-void Camera::update(InputState& inputs, float deltaTime)
+void Camera::update(const InputState& inputs, float deltaTime)
 {
     const float PI = 3.14159265359f;
     // TODO: make adjustable through user inputs?
@@ -53,6 +53,16 @@ glm::mat3 Camera::getRotation()
     return glm::mat3_cast(glm::normalize(pitchRotation * yawRotation));
 }
 
+float Camera::getPitch()
+{
+    return pitch;
+}
+
+float Camera::getYaw()
+{
+    return yaw;
+}
+
 float Camera::getAspectRatio()
 {
     return (float)width / height;
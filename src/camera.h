@@ -20,10 +20,12 @@ public:
     // Changes the camera based on a a window resize.
     void resize(uint width, uint height);
     // Updates the camera with user inputs.
-    void update(InputState& inputs, float deltaTime);
+    void update(const InputState& inputs, float deltaTime);
 
     glm::vec3 getPosition();
     glm::mat3 getRotation();
+    float getPitch();
+    float getYaw();
     float getAspectRatio();
 
 private:
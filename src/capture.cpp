@@ -0,0 +1,347 @@
+#include "capture.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool FrameCapture::init(CaptureFormat format, const std::string& path, unsigned int fps)
+{
+    this->format = format;
+    this->path = path;
+    this->fps = fps;
+    if (format == CaptureFormat::None) {
+        return true;
+    }
+    if (format == CaptureFormat::Png) {
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        if (error) {
+            std::cerr << "Failed to create capture directory " << path << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+    for (auto& slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    stopping = false;
+    encoder = std::thread(&FrameCapture::encodeLoop, this);
+    std::cout << "Frame capture ready, writing to " << path << "." << std::endl;
+    return true;
+}
+
+bool FrameCapture::isEnabled()
+{
+    return format != CaptureFormat::None;
+}
+
+bool FrameCapture::isRecording()
+{
+    return recording;
+}
+
+void FrameCapture::setRecording(bool recording)
+{
+    // called every frame, so only changes are reported
+    if (!isEnabled() || recording == this->recording) {
+        return;
+    }
+    this->recording = recording;
+    std::cout << (recording ? "Started" : "Stopped") << " frame capture." << std::endl;
+}
+
+void FrameCapture::capture(unsigned int width, unsigned int height)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    collect(false);
+    if (!recording) {
+        return;
+    }
+    if (pending == CAPTURE_RING_SIZE) {
+        // the GPU is more than CAPTURE_RING_SIZE frames behind, waiting would stall
+        droppedFrames += 1;
+        return;
+    }
+    Slot& slot = slots[head];
+    size_t size = (size_t)width * height * 4;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    // asynchronous since a pack buffer is bound
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.index = frameIndex++;
+    head = (head + 1) % CAPTURE_RING_SIZE;
+    pending += 1;
+}
+
+void FrameCapture::collect(bool wait)
+{
+    while (pending > 0) {
+        Slot& slot = slots[(head + CAPTURE_RING_SIZE - pending) % CAPTURE_RING_SIZE];
+        // flush when blocking, otherwise the fence might never signal
+        GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+        GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            if (status == GL_WAIT_FAILED) {
+                std::cerr << "Frame capture fence wait failed." << std::endl;
+            }
+            return;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        pending -= 1;
+
+        Frame frame;
+        frame.width = slot.width;
+        frame.height = slot.height;
+        frame.index = slot.index;
+        {
+            std::lock_guard lock(mutex);
+            if (queue.size() >= CAPTURE_MAX_QUEUED_FRAMES) {
+                // the encoder cannot keep up
+                droppedFrames += 1;
+                continue;
+            }
+            if (!freePixels.empty()) {
+                frame.pixels = std::move(freePixels.back());
+                freePixels.pop_back();
+            }
+        }
+        size_t size = (size_t)slot.width * slot.height * 4;
+        frame.pixels.resize(size);
+        void* data = glMapNamedBufferRange(slot.buffer, 0, size, GL_MAP_READ_BIT);
+        if (data == nullptr) {
+            std::cerr << "Failed to map frame capture buffer." << std::endl;
+            continue;
+        }
+        std::memcpy(frame.pixels.data(), data, size);
+        glUnmapNamedBuffer(slot.buffer);
+        {
+            std::lock_guard lock(mutex);
+            queue.push_back(std::move(frame));
+        }
+        condition.notify_one();
+    }
+}
+
+void FrameCapture::destroy()
+{
+    if (!isEnabled()) {
+        return;
+    }
+    collect(true);
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_one();
+    if (encoder.joinable()) {
+        encoder.join();
+    }
+    for (auto& slot : slots) {
+        if (slot.buffer)
+            glDeleteBuffers(1, &slot.buffer);
+        slot = Slot {};
+    }
+    if (droppedFrames > 0) {
+        std::cerr << "Frame capture dropped " << droppedFrames << " frames." << std::endl;
+    }
+    std::cout << "Captured " << writtenFrames << " frames to " << path << "." << std::endl;
+    format = CaptureFormat::None;
+}
+
+void FrameCapture::encodeLoop()
+{
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                // stopping and everything has been encoded
+                break;
+            }
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        encode(frame);
+        writtenFrames += 1;
+        {
+            std::lock_guard lock(mutex);
+            freePixels.push_back(std::move(frame.pixels));
+        }
+    }
+    if (video.is_open()) {
+        video.close();
+    }
+}
+
+void FrameCapture::encode(const Frame& frame)
+{
+    switch (format) {
+    case CaptureFormat::Png:
+        writePng(frame);
+        break;
+    case CaptureFormat::Y4m:
+        writeY4m(frame);
+        break;
+    case CaptureFormat::None:
+        break;
+    }
+}
+
+// CRC-32 as used by PNG chunks
+static uint32_t pngCrc32(const uint8_t* data, size_t length, uint32_t crc = 0)
+{
+    static uint32_t table[256] = {};
+    static bool tableInitialized = false;
+    if (!tableInitialized) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        tableInitialized = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void appendU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void writePngChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    appendU32(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // the CRC covers the type and data but not the length
+    appendU32(chunk, pngCrc32(chunk.data() + 4, chunk.size() - 4));
+    file.write((const char*)chunk.data(), chunk.size());
+}
+
+// Writes an 8-bit RGB PNG. The image data is stored uncompressed,
+// since compressing would make the encoder the bottleneck.
+void FrameCapture::writePng(const Frame& frame)
+{
+    std::ostringstream name;
+    name << path << "/frame_" << std::setw(6) << std::setfill('0') << frame.index << ".png";
+    std::ofstream file(name.str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << name.str() << " for writing." << std::endl;
+        return;
+    }
+    const uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write((const char*)SIGNATURE, sizeof(SIGNATURE));
+
+    std::vector<uint8_t> header;
+    appendU32(header, frame.width);
+    appendU32(header, frame.height);
+    // bit depth 8, color type RGB, default compression, filter and interlace method
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+    writePngChunk(file, "IHDR", header);
+
+    // rows with a leading filter type byte, flipped so that the top row comes first
+    size_t rowSize = 1 + (size_t)frame.width * 3;
+    std::vector<uint8_t> raw(rowSize * frame.height);
+    for (size_t y = 0; y < frame.height; y++) {
+        const uint8_t* src = &frame.pixels[(frame.height - 1 - y) * frame.width * 4];
+        uint8_t* dst = &raw[y * rowSize];
+        dst[0] = 0;
+        for (size_t x = 0; x < frame.width; x++) {
+            dst[1 + x * 3 + 0] = src[x * 4 + 0];
+            dst[1 + x * 3 + 1] = src[x * 4 + 1];
+            dst[1 + x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+    // zlib stream made of stored deflate blocks
+    const size_t MAX_BLOCK = 65535;
+    std::vector<uint8_t> data;
+    data.reserve(raw.size() + raw.size() / MAX_BLOCK * 5 + 16);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    for (size_t offset = 0; offset < raw.size(); offset += MAX_BLOCK) {
+        size_t length = std::min(MAX_BLOCK, raw.size() - offset);
+        bool last = offset + length >= raw.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back(length & 0xff);
+        data.push_back(length >> 8);
+        data.push_back(~length & 0xff);
+        data.push_back((~length >> 8) & 0xff);
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendU32(data, (b << 16) | a);
+    writePngChunk(file, "IDAT", data);
+    writePngChunk(file, "IEND", {});
+}
+
+// Appends a frame to a 4:4:4 Y4M video using BT.601 limited range.
+// Frames that do not match the size of the first frame are skipped,
+// since Y4M does not support changing the resolution.
+void FrameCapture::writeY4m(const Frame& frame)
+{
+    if (!video.is_open()) {
+        video.open(path, std::ios::binary);
+        if (!video.is_open()) {
+            std::cerr << "Failed to open " << path << " for writing." << std::endl;
+            return;
+        }
+        videoWidth = frame.width;
+        videoHeight = frame.height;
+        video << "YUV4MPEG2 W" << videoWidth << " H" << videoHeight << " F" << fps << ":1 Ip A1:1 C444\n";
+    }
+    if (frame.width != videoWidth || frame.height != videoHeight) {
+        std::cerr << "Skipping captured frame " << frame.index << ": size differs from the video." << std::endl;
+        return;
+    }
+    size_t pixelCount = (size_t)frame.width * frame.height;
+    std::vector<uint8_t> planes(pixelCount * 3);
+    uint8_t* yPlane = planes.data();
+    uint8_t* uPlane = yPlane + pixelCount;
+    uint8_t* vPlane = uPlane + pixelCount;
+
+    for (size_t y = 0; y < frame.height; y++) {
+        const uint8_t* src = &frame.pixels[(frame.height - 1 - y) * frame.width * 4];
+        for (size_t x = 0; x < frame.width; x++) {
+            int r = src[x * 4 + 0];
+            int g = src[x * 4 + 1];
+            int b = src[x * 4 + 2];
+            size_t i = y * frame.width + x;
+            yPlane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            uPlane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            vPlane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+    video << "FRAME\n";
+    video.write((const char*)planes.data(), planes.size());
+}
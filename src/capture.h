@@ -0,0 +1,96 @@
+#pragma once
+
+#include "options.h"
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Number of pixel-pack buffers in flight.
+// A readback is mapped CAPTURE_RING_SIZE - 1 frames after it was issued at the earliest.
+const unsigned int CAPTURE_RING_SIZE = 4;
+// Frames waiting for the encoder beyond this are dropped instead of stalling the renderer.
+const size_t CAPTURE_MAX_QUEUED_FRAMES = 16;
+
+// Captures the back buffer without stalling the pipeline.
+//
+// Each frame is read into a pixel-pack buffer guarded by a fence. The buffer is
+// only mapped once its fence has signaled, a few frames later, and the pixels
+// are handed to an encoder thread that writes them to disk.
+class FrameCapture {
+public:
+    FrameCapture()
+    {
+    }
+
+    // Starts the encoder thread. Does nothing if FORMAT is CaptureFormat::None.
+    bool init(CaptureFormat format, const std::string& path, unsigned int fps);
+    // Queues a readback of the current back buffer of size WIDTH x HEIGHT.
+    // Call before swapping buffers.
+    void capture(unsigned int width, unsigned int height);
+    // Waits for the outstanding readbacks and encodes the remaining frames.
+    void destroy();
+
+    bool isEnabled();
+    bool isRecording();
+    void setRecording(bool recording);
+
+private:
+    // An RGBA8 image with the bottom row first, as returned by OpenGL.
+    struct Frame {
+        std::vector<uint8_t> pixels;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        uint64_t index = 0;
+    };
+
+    struct Slot {
+        GLuint buffer = 0;
+        // allocated size of buffer in bytes
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        uint64_t index = 0;
+    };
+
+    // Maps the readbacks that have finished, in order.
+    // Blocks on the oldest fence if WAIT is true.
+    void collect(bool wait);
+    void encodeLoop();
+    void encode(const Frame& frame);
+    void writePng(const Frame& frame);
+    void writeY4m(const Frame& frame);
+
+    CaptureFormat format = CaptureFormat::None;
+    std::string path;
+    unsigned int fps = 60;
+    bool recording = false;
+
+    Slot slots[CAPTURE_RING_SIZE];
+    // next slot to write into, oldest pending slot is (head + CAPTURE_RING_SIZE - pending) % CAPTURE_RING_SIZE
+    unsigned int head = 0;
+    unsigned int pending = 0;
+    uint64_t frameIndex = 0;
+    uint64_t droppedFrames = 0;
+    // frames handed to the encoder, only accessed by the encoder thread until it is joined
+    uint64_t writtenFrames = 0;
+
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Frame> queue;
+    // pixel storage returned by the encoder for reuse
+    std::vector<std::vector<uint8_t>> freePixels;
+    bool stopping = false;
+
+    // encoder thread only
+    std::ofstream video;
+    unsigned int videoWidth = 0;
+    unsigned int videoHeight = 0;
+};
@@ -1,22 +1,27 @@
 #pragma once
 
 #include <SDL2/SDL_events.h>
+#include <SDL2/SDL_keyboard.h>
+#include <bitset>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
-#include <unordered_set>
 
+// Keyboard and mouse input of one simulation step.
+// Keys are stored by scancode in fixed-size bitsets, so handling input never allocates.
 struct InputState {
-    std::unordered_set<SDL_Keycode> pressed = {};
-    std::unordered_set<SDL_Keycode> held = {};
+    // keys that went down during this step
+    std::bitset<SDL_NUM_SCANCODES> pressed;
+    // keys that are down
+    std::bitset<SDL_NUM_SCANCODES> held;
     glm::vec2 mouseDelta = glm::vec2(0.0);
 
-    bool isPressed(SDL_Keycode key)
+    bool isPressed(SDL_Keycode key) const
     {
-        return pressed.find(key) != pressed.end();
+        return pressed[SDL_GetScancodeFromKey(key)];
     }
 
-    bool isHeld(SDL_Keycode key)
+    bool isHeld(SDL_Keycode key) const
     {
-        return held.find(key) != held.end();
+        return held[SDL_GetScancodeFromKey(key)];
     }
 };
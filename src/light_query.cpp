@@ -0,0 +1,157 @@
+#include "light_query.h"
+#include "scene.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+bool LightQueries::init()
+{
+    GLuint shader = loadShader(GL_COMPUTE_SHADER, "light_query.glsl");
+    if (!program.init({ shader }, {})) {
+        std::cerr << "Failed to initialize OpenGL state (lightQueryProgram error)." << std::endl;
+        return false;
+    }
+    const GLbitfield WRITE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLbitfield READ_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &queryBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, queryBuffer);
+    assert(glIsBuffer(queryBuffer));
+    glNamedBufferStorage(queryBuffer, LIGHT_QUERY_RING_SIZE * MAX_LIGHT_QUERIES * sizeof(Query), nullptr, WRITE_FLAGS);
+    queryData = glMapNamedBufferRange(queryBuffer, 0, LIGHT_QUERY_RING_SIZE * MAX_LIGHT_QUERIES * sizeof(Query), WRITE_FLAGS);
+
+    glGenBuffers(1, &resultBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, resultBuffer);
+    assert(glIsBuffer(resultBuffer));
+    glNamedBufferStorage(resultBuffer, LIGHT_QUERY_RING_SIZE * MAX_LIGHT_QUERIES * sizeof(glm::vec4), nullptr, READ_FLAGS);
+    resultData = glMapNamedBufferRange(resultBuffer, 0, LIGHT_QUERY_RING_SIZE * MAX_LIGHT_QUERIES * sizeof(glm::vec4), READ_FLAGS);
+
+    if (queryData == nullptr || resultData == nullptr) {
+        std::cerr << "Failed to map the light query buffers." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void LightQueries::destroy()
+{
+    for (auto& batch : batches) {
+        if (batch.fence)
+            glDeleteSync(batch.fence);
+        batch = Batch {};
+    }
+    if (queryBuffer) {
+        glUnmapNamedBuffer(queryBuffer);
+        glDeleteBuffers(1, &queryBuffer);
+    }
+    if (resultBuffer) {
+        glUnmapNamedBuffer(resultBuffer);
+        glDeleteBuffers(1, &resultBuffer);
+    }
+    program.destroy();
+}
+
+void LightQueries::queryPoint(glm::vec3 point, LightCallback callback)
+{
+    queued.push_back(Query { point, LIGHT_QUERY_POINT });
+    queuedCallbacks.push_back(std::move(callback));
+}
+
+void LightQueries::queryFace(glm::ivec3 index, glm::uint face, LightCallback callback)
+{
+    queued.push_back(Query { glm::vec3(index), face });
+    queuedCallbacks.push_back(std::move(callback));
+}
+
+LightCallback LightQueries::fillResult(const LightResult& result)
+{
+    return [state = result.state](glm::vec3 color) {
+        state->color = color;
+        state->ready.store(true, std::memory_order_release);
+    };
+}
+
+LightResult LightQueries::queryPoint(glm::vec3 point)
+{
+    LightResult result;
+    queryPoint(point, fillResult(result));
+    return result;
+}
+
+LightResult LightQueries::queryFace(glm::ivec3 index, glm::uint face)
+{
+    LightResult result;
+    queryFace(index, face, fillResult(result));
+    return result;
+}
+
+LightQueries::Query* LightQueries::slotQueries(unsigned int slot)
+{
+    return (Query*)queryData + slot * MAX_LIGHT_QUERIES;
+}
+
+glm::vec4* LightQueries::slotResults(unsigned int slot)
+{
+    return (glm::vec4*)resultData + slot * MAX_LIGHT_QUERIES;
+}
+
+void LightQueries::collect()
+{
+    while (inFlight > 0) {
+        unsigned int slot = (head + LIGHT_QUERY_RING_SIZE - inFlight) % LIGHT_QUERY_RING_SIZE;
+        Batch& batch = batches[slot];
+        GLenum status = glClientWaitSync(batch.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            return;
+        }
+        glDeleteSync(batch.fence);
+        batch.fence = nullptr;
+        inFlight -= 1;
+
+        glm::vec4* results = slotResults(slot);
+        for (size_t i = 0; i < batch.callbacks.size(); i++) {
+            batch.callbacks[i](glm::vec3(results[i]));
+        }
+        // keeps the capacity for the next batch in this slot
+        batch.callbacks.clear();
+    }
+}
+
+void LightQueries::update(GLuint dbColorReadIdx, bool useFiltered)
+{
+    collect();
+
+    if (queued.empty() || inFlight == LIGHT_QUERY_RING_SIZE) {
+        return;
+    }
+    unsigned int slot = head;
+    Batch& batch = batches[slot];
+    size_t count = std::min(queued.size(), MAX_LIGHT_QUERIES);
+
+    // the slot is free, so the GPU no longer reads this part of the mapping
+    std::memcpy(slotQueries(slot), queued.data(), count * sizeof(Query));
+    batch.callbacks.assign(
+        std::make_move_iterator(queuedCallbacks.begin()),
+        std::make_move_iterator(queuedCallbacks.begin() + count));
+    // erasing keeps the capacity for the next frame
+    queued.erase(queued.begin(), queued.begin() + count);
+    queuedCallbacks.erase(queuedCallbacks.begin(), queuedCallbacks.begin() + count);
+
+    program.use();
+    glUniform1ui(program.getUniformLocation("dbColorReadIdx"), dbColorReadIdx);
+    glUniform1ui(program.getUniformLocation("queryCount"), count);
+    glUniform1i(program.getUniformLocation("useFiltered"), useFiltered);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_QUERY_BINDING, queryBuffer,
+        slot * MAX_LIGHT_QUERIES * sizeof(Query), count * sizeof(Query));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_QUERY_RESULT_BINDING, resultBuffer,
+        slot * MAX_LIGHT_QUERIES * sizeof(glm::vec4), count * sizeof(glm::vec4));
+    glDispatchCompute((count + LIGHT_QUERY_WORKGROUP_SIZE - 1) / LIGHT_QUERY_WORKGROUP_SIZE, 1, 1);
+    // makes the shader writes visible through the persistent mapping once the fence signals
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    head = (head + 1) % LIGHT_QUERY_RING_SIZE;
+    inFlight += 1;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "shader.h"
+#include <GL/glew.h>
+#include <atomic>
+#include <functional>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <vector>
+
+// mirrored in light_query.glsl
+// face value marking a query for a point instead of a voxel face
+const glm::uint LIGHT_QUERY_POINT = 6;
+// number of batches that can be in flight on the GPU
+const unsigned int LIGHT_QUERY_RING_SIZE = 3;
+// maximum number of queries per batch, the rest is evaluated in later frames
+const size_t MAX_LIGHT_QUERIES = 1 << 16;
+// mirrored in light_query.glsl
+const unsigned int LIGHT_QUERY_WORKGROUP_SIZE = 64;
+
+// Called with the color at the queried face or point.
+using LightCallback = std::function<void(glm::vec3)>;
+
+// The color at a queried face or point, filled in by LightQueries::update().
+//
+// Meant to be polled: the result only arrives while the thread that owns the
+// OpenGL context keeps calling update(), so that thread must never wait for it.
+// The query itself must be issued on that thread too. A LightResult that was
+// returned there may be handed to another thread, which can then poll it.
+class LightResult {
+public:
+    bool isReady() const
+    {
+        return state->ready.load(std::memory_order_acquire);
+    }
+
+    // Returns the color. Only valid once isReady() returns true.
+    glm::vec3 get() const
+    {
+        return state->color;
+    }
+
+private:
+    friend class LightQueries;
+
+    struct State {
+        glm::vec3 color = glm::vec3(0.0f);
+        std::atomic<bool> ready { false };
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+};
+
+// Batched light level queries.
+//
+// Queries collected during a frame are evaluated in a single compute dispatch.
+// The results are written to a persistently mapped buffer guarded by a fence
+// and handed to the callbacks one or two frames later, so the CPU never waits
+// for the GPU.
+class LightQueries {
+public:
+    LightQueries()
+    {
+    }
+
+    // Creates the buffers and the compute shader.
+    bool init();
+    // Drops the queries that have not finished.
+    void destroy();
+
+    // Queues a query for the light level at POINT in voxel coordinates.
+    void queryPoint(glm::vec3 point, LightCallback callback);
+    // Queues a query for the color of FACE of the voxel at INDEX.
+    void queryFace(glm::ivec3 index, glm::uint face, LightCallback callback);
+    // Same as above, but the result is polled through the returned LightResult.
+    // Like all functions here, these are not synchronized and must be called on
+    // the thread that owns the OpenGL context.
+    LightResult queryPoint(glm::vec3 point);
+    LightResult queryFace(glm::ivec3 index, glm::uint face);
+
+    // Calls the callbacks of finished batches and dispatches the queued queries.
+    // Reads the face colors at DB_COLOR_READ_IDX, or the denoised ones if USE_FILTERED is set.
+    void update(GLuint dbColorReadIdx, bool useFiltered);
+
+private:
+    // mirrored in light_query.glsl
+    struct alignas(16) Query {
+        glm::vec3 position;
+        glm::uint face;
+    };
+
+    struct Batch {
+        GLsync fence = nullptr;
+        std::vector<LightCallback> callbacks;
+    };
+
+    // Returns a callback that stores the color in RESULT and marks it ready.
+    static LightCallback fillResult(const LightResult& result);
+    // Calls the callbacks of the batches whose fence has signaled, in order.
+    void collect();
+    Query* slotQueries(unsigned int slot);
+    glm::vec4* slotResults(unsigned int slot);
+
+    ShaderProgram program;
+    GLuint queryBuffer = 0;
+    GLuint resultBuffer = 0;
+    // persistent mappings of queryBuffer and resultBuffer
+    void* queryData = nullptr;
+    void* resultData = nullptr;
+
+    Batch batches[LIGHT_QUERY_RING_SIZE];
+    // next batch to dispatch, the oldest one in flight is (head + LIGHT_QUERY_RING_SIZE - inFlight) % LIGHT_QUERY_RING_SIZE
+    unsigned int head = 0;
+    unsigned int inFlight = 0;
+
+    // queries waiting for dispatch
+    std::vector<Query> queued;
+    std::vector<LightCallback> queuedCallbacks;
+};
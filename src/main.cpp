@@ -1,13 +1,24 @@
 #include "app.h"
+#include "options.h"
 #include "sdl.h"
+#include "util.h"
 
-int main()
+int main(int argc, char** argv)
 {
-    SDLState<App> sdlState;
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return EXIT_FAILURE;
+    // seed before the scene is generated
+    if (options.seed)
+        seedRandom(*options.seed);
+
+    SDLState<App> sdlState { options };
 
     if (!sdlState.init())
         return EXIT_FAILURE;
 
     sdlState.run();
+    // flushes outstanding frame captures
+    sdlState.destroy();
     return EXIT_SUCCESS;
 }
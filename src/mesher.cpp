@@ -0,0 +1,183 @@
+#include "mesher.h"
+#include "util.h"
+#include <cassert>
+#include <cstddef>
+
+size_t ChunkMesher::brickIndex(glm::ivec3 brick) const
+{
+    return (brick.x * bricksPerAxis + brick.y) * bricksPerAxis + brick.z;
+}
+
+glm::ivec3 ChunkMesher::brickPosition(size_t index) const
+{
+    return glm::ivec3(
+        index / (bricksPerAxis * bricksPerAxis),
+        (index / bricksPerAxis) % bricksPerAxis,
+        index % bricksPerAxis);
+}
+
+void ChunkMesher::init(glm::uint chunkSize)
+{
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    // the vertex buffer of each brick is bound to binding 0 when drawing
+    GLint posAttr = 0;
+    GLint faceAttr = 1;
+    glVertexAttribFormat(posAttr, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position));
+    glVertexAttribIFormat(faceAttr, 1, GL_UNSIGNED_INT, offsetof(MeshVertex, face));
+    glVertexAttribBinding(posAttr, 0);
+    glVertexAttribBinding(faceAttr, 0);
+    glEnableVertexAttribArray(posAttr);
+    glEnableVertexAttribArray(faceAttr);
+
+    bricksPerAxis = chunkSize / BRICK_SIZE;
+    bricks = std::vector<Brick>(bricksPerAxis * bricksPerAxis * bricksPerAxis);
+    for (auto& brick : bricks) {
+        glGenBuffers(1, &brick.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, brick.buffer);
+        assert(glIsBuffer(brick.buffer));
+        brick.dirty = true;
+    }
+}
+
+void ChunkMesher::destroy()
+{
+    for (auto& brick : bricks) {
+        if (brick.buffer)
+            glDeleteBuffers(1, &brick.buffer);
+    }
+    bricks.clear();
+    if (vertexArray)
+        glDeleteVertexArrays(1, &vertexArray);
+}
+
+void ChunkMesher::markDirty(glm::ivec3 index)
+{
+    // a voxel on the border of a brick changes which faces of the neighboring brick are exposed
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                glm::ivec3 neighbor = index + glm::ivec3(dx, dy, dz);
+                if (glm::any(glm::lessThan(neighbor, glm::ivec3(0)))
+                    || glm::any(glm::greaterThanEqual(neighbor, glm::ivec3(bricksPerAxis * BRICK_SIZE)))) {
+                    continue;
+                }
+                bricks[brickIndex(neighbor / (int)BRICK_SIZE)].dirty = true;
+            }
+        }
+    }
+}
+
+void ChunkMesher::update(const Chunk& chunk)
+{
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < bricks.size(); i++) {
+        if (bricks[i].dirty)
+            dirty.push_back(i);
+    }
+    if (dirty.empty()) {
+        return;
+    }
+
+    // the workers only read the chunk and each writes to distinct bricks
+    parallelFor(dirty.size(), [&](size_t i) {
+        Brick& brick = bricks[dirty[i]];
+        brick.vertices.clear();
+        meshBrick(chunk, brickPosition(dirty[i]), brick.vertices);
+    });
+
+    for (size_t i : dirty) {
+        Brick& brick = bricks[i];
+        glNamedBufferData(brick.buffer, brick.vertices.size() * sizeof(MeshVertex), brick.vertices.data(), GL_STATIC_DRAW);
+        brick.vertexCount = brick.vertices.size();
+        brick.dirty = false;
+    }
+}
+
+void ChunkMesher::draw()
+{
+    glBindVertexArray(vertexArray);
+    for (auto& brick : bricks) {
+        if (brick.vertexCount == 0)
+            continue;
+        glBindVertexBuffer(0, brick.buffer, 0, sizeof(MeshVertex));
+        glDrawArrays(GL_TRIANGLES, 0, brick.vertexCount);
+    }
+}
+
+// Returns true if mask[i][j] is set for all i in [START, START + WIDTH).
+static bool isRowSet(const bool mask[BRICK_SIZE][BRICK_SIZE], int start, int width, int j)
+{
+    for (int i = start; i < start + width; i++) {
+        if (!mask[i][j])
+            return false;
+    }
+    return true;
+}
+
+void ChunkMesher::meshBrick(const Chunk& chunk, glm::ivec3 brick, std::vector<MeshVertex>& vertices)
+{
+    glm::ivec3 origin = brick * (int)BRICK_SIZE;
+    // exposed faces in the current slice, indexed by [u][v]
+    bool mask[BRICK_SIZE][BRICK_SIZE];
+
+    for (glm::uint face = 0; face < 6; face++) {
+        // the axis along the normal and the two axes along the face
+        int d = face / 2;
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+        bool positive = face & 1;
+        glm::ivec3 normal = glm::ivec3(0);
+        normal[d] = positive ? 1 : -1;
+
+        for (int slice = 0; slice < BRICK_SIZE; slice++) {
+            for (int i = 0; i < BRICK_SIZE; i++) {
+                for (int j = 0; j < BRICK_SIZE; j++) {
+                    glm::ivec3 index = origin;
+                    index[d] += slice;
+                    index[u] += i;
+                    index[v] += j;
+                    mask[i][j] = chunk.isSolid(index) && !chunk.isSolid(index + normal);
+                }
+            }
+            // the plane the faces lie in
+            float plane = origin[d] + slice + (positive ? 1 : 0);
+
+            for (int i = 0; i < BRICK_SIZE; i++) {
+                for (int j = 0; j < BRICK_SIZE; j++) {
+                    if (!mask[i][j]) {
+                        continue;
+                    }
+                    // grow along u, then along v while the whole row is exposed
+                    int width = 1;
+                    while (i + width < BRICK_SIZE && mask[i + width][j]) {
+                        width++;
+                    }
+                    int height = 1;
+                    while (j + height < BRICK_SIZE && isRowSet(mask, i, width, j + height)) {
+                        height++;
+                    }
+                    for (int a = i; a < i + width; a++) {
+                        for (int b = j; b < j + height; b++) {
+                            mask[a][b] = false;
+                        }
+                    }
+
+                    auto corner = [&](int du, int dv) {
+                        glm::vec3 position;
+                        position[d] = plane;
+                        position[u] = origin[u] + i + du;
+                        position[v] = origin[v] + j + dv;
+                        return MeshVertex { position, face };
+                    };
+                    vertices.push_back(corner(0, 0));
+                    vertices.push_back(corner(width, 0));
+                    vertices.push_back(corner(width, height));
+                    vertices.push_back(corner(0, 0));
+                    vertices.push_back(corner(width, height));
+                    vertices.push_back(corner(0, height));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "scene.h"
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <vector>
+
+// size of a brick in one dimension, the unit in which the mesh is rebuilt
+const long BRICK_SIZE = 8;
+static_assert(VOXEL_WORKGROUP_SIZE % BRICK_SIZE == 0, "chunk sizes must be a multiple of BRICK_SIZE");
+
+// mirrored in mesh_vert.glsl
+struct MeshVertex {
+    glm::vec3 position;
+    // face of the voxel that the quad belongs to, see voxelFaceToNormal()
+    glm::uint face;
+};
+
+// Greedy meshes of the exposed voxel faces, split into bricks.
+//
+// Coplanar exposed faces with the same normal are merged into quads, so the
+// number of triangles depends on the shape of the surfaces rather than on the
+// number of voxels. Only bricks that were marked dirty are rebuilt, in parallel.
+class ChunkMesher {
+public:
+    ChunkMesher()
+    {
+    }
+
+    // Creates the vertex array and the bricks of a chunk of CHUNK_SIZE in each dimension
+    // and marks every brick dirty.
+    void init(glm::uint chunkSize);
+    void destroy();
+    // Marks the bricks whose mesh depends on the voxel at INDEX.
+    void markDirty(glm::ivec3 index);
+    // Rebuilds the dirty bricks on worker threads and uploads them.
+    void update(const Chunk& chunk);
+    // Draws all bricks. Expects the mesh shader program to be in use.
+    void draw();
+
+    // Appends the quads of the exposed faces in the brick at BRICK to VERTICES,
+    // as two triangles each.
+    static void meshBrick(const Chunk& chunk, glm::ivec3 brick, std::vector<MeshVertex>& vertices);
+
+private:
+    struct Brick {
+        GLuint buffer = 0;
+        GLsizei vertexCount = 0;
+        bool dirty = true;
+        // kept to reuse the allocation when the brick is rebuilt
+        std::vector<MeshVertex> vertices;
+    };
+
+    size_t brickIndex(glm::ivec3 brick) const;
+    glm::ivec3 brickPosition(size_t index) const;
+
+    // bricksPerAxis³ bricks, in [x][y][z] order
+    std::vector<Brick> bricks;
+    int bricksPerAxis = 0;
+    GLuint vertexArray = 0;
+};
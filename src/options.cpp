@@ -0,0 +1,203 @@
+#include "options.h"
+#include "scene.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --capture-png DIR     write captured frames as numbered PNG files to DIR\n"
+              << "  --capture-y4m FILE    write captured frames as Y4M video to FILE\n"
+              << "  --capture-fps N       frame rate stored in the Y4M header (default 60)\n"
+              << "  --capture-on-start    start capturing immediately (otherwise toggle with F12)\n"
+              << "  --record FILE         record the per-frame inputs to FILE\n"
+              << "  --replay FILE         replay the inputs recorded in FILE, then exit\n"
+              << "  --timestep MS         fixed frame time in milliseconds used during replay\n"
+              << "  --seed N              seed for the random number generator (default 0 when recording or replaying)\n"
+              << "  --frame-log FILE      write per-frame timings and camera poses to FILE as CSV\n"
+              << "  --denoise N           number of denoise filter iterations, 0 to disable (default 3)\n"
+              << "  --denoise-feedback    bounce light off the denoised colors\n"
+              << "  --gather MODE         light gathering: ray, sweep or sweep-cpu (default ray)\n"
+              << "  --priority-interval N frames between light updates of voxels out of view (default 4)\n"
+              << "  --ray-budget N        rays cast by the light update per frame, 0 for no limit (default 0)\n"
+              << "  --check-schedule      report voxels the prioritized light update misses or updates twice (slow)\n"
+              << "  --raster              rasterize greedy meshes instead of ray casting (toggle with R)\n"
+              << "  --scene NAME          scene to display (invertedSphere, simple, cornellBox, outside)\n"
+              << "  --chunk-size N        size of the chunks in voxels per dimension, a multiple of 8 up to 128 (default 32)\n"
+              << "  --bake NAME,NAME,...  bake the given scenes in a single batch, then exit; a scene always\n"
+              << "                        has the same materials, repeated names only differ in their random seed\n"
+              << "  --bake-out DIR        directory to write the baked scenes to (default bake)\n"
+              << "  --bake-threshold F    relative luminance change per frame at which a scene has converged (default 0.005)\n"
+              << "  --bake-max-frames N   frames after which a scene is written out regardless (default 20000)\n"
+              << std::endl;
+}
+
+// Parses a non-negative integer, returning false if TEXT is not one
+// or does not fit into an unsigned int.
+static bool parseUint(const std::string& text, unsigned int& out)
+{
+    char* end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(text.c_str(), &end, 10);
+    if (text.empty() || text[0] == '-' || *end != '\0' || errno == ERANGE || value > UINT_MAX) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+// Parses a non-negative number, returning false if TEXT is not one.
+static bool parseFloat(const std::string& text, float& out)
+{
+    char* end = nullptr;
+    float value = std::strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !(value >= 0.0f)) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        // the value following the current argument, empty if missing
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        bool takesValue = true;
+
+        if (arg == "--capture-png" || arg == "--capture-y4m") {
+            options.captureFormat = arg == "--capture-png" ? CaptureFormat::Png : CaptureFormat::Y4m;
+            options.capturePath = value;
+        } else if (arg == "--capture-fps") {
+            if (!parseUint(value, options.captureFps) || options.captureFps == 0) {
+                std::cerr << "Invalid frame rate \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--record") {
+            options.recordPath = value;
+        } else if (arg == "--replay") {
+            options.replayPath = value;
+        } else if (arg == "--timestep") {
+            if (!parseFloat(value, options.timestep)) {
+                std::cerr << "Invalid timestep \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--seed") {
+            unsigned int seed = 0;
+            if (!parseUint(value, seed)) {
+                std::cerr << "Invalid seed \"" << value << "\"." << std::endl;
+                return false;
+            }
+            options.seed = seed;
+        } else if (arg == "--frame-log") {
+            options.frameLogPath = value;
+        } else if (arg == "--denoise") {
+            if (!parseUint(value, options.denoiseIterations) || options.denoiseIterations > 8) {
+                std::cerr << "Invalid denoise iteration count \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--denoise-feedback") {
+            options.denoiseFeedback = true;
+            takesValue = false;
+        } else if (arg == "--gather") {
+            if (value == "ray") {
+                options.gather = GatherMode::Ray;
+            } else if (value == "sweep") {
+                options.gather = GatherMode::Sweep;
+            } else if (value == "sweep-cpu") {
+                options.gather = GatherMode::SweepCpu;
+            } else {
+                std::cerr << "Invalid gather mode \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--priority-interval") {
+            if (!parseUint(value, options.priorityInterval) || options.priorityInterval == 0) {
+                std::cerr << "Invalid priority interval \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--ray-budget") {
+            if (!parseUint(value, options.rayBudget)) {
+                std::cerr << "Invalid ray budget \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--check-schedule") {
+            options.checkSchedule = true;
+            takesValue = false;
+        } else if (arg == "--raster") {
+            options.raster = true;
+            takesValue = false;
+        } else if (arg == "--scene") {
+            options.scene = value;
+        } else if (arg == "--chunk-size") {
+            if (!parseUint(value, options.chunkSize) || options.chunkSize == 0
+                || options.chunkSize % VOXEL_WORKGROUP_SIZE != 0 || options.chunkSize > MAX_CHUNK_SIZE) {
+                std::cerr << "Invalid chunk size \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--bake") {
+            options.bakeScenes.clear();
+            std::stringstream names(value);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (!name.empty())
+                    options.bakeScenes.push_back(name);
+            }
+        } else if (arg == "--bake-out") {
+            options.bakeOutput = value;
+        } else if (arg == "--bake-threshold") {
+            if (!parseFloat(value, options.bakeThreshold)) {
+                std::cerr << "Invalid bake threshold \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--bake-max-frames") {
+            if (!parseUint(value, options.bakeMaxFrames) || options.bakeMaxFrames == 0) {
+                std::cerr << "Invalid frame count \"" << value << "\"." << std::endl;
+                return false;
+            }
+        } else if (arg == "--capture-on-start") {
+            options.captureOnStart = true;
+            takesValue = false;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return false;
+        } else {
+            std::cerr << "Unknown argument " << arg << "." << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+
+        if (takesValue) {
+            if (value.empty()) {
+                std::cerr << "Missing value for " << arg << "." << std::endl;
+                return false;
+            }
+            i++;
+        }
+    }
+    if (options.captureOnStart && options.captureFormat == CaptureFormat::None) {
+        std::cerr << "--capture-on-start requires --capture-png or --capture-y4m." << std::endl;
+        return false;
+    }
+    if (!options.recordPath.empty() && !options.replayPath.empty()) {
+        std::cerr << "--record and --replay cannot be used together." << std::endl;
+        return false;
+    }
+    if (options.timestep > 0.0f && options.replayPath.empty()) {
+        std::cerr << "--timestep requires --replay." << std::endl;
+        return false;
+    }
+    if (options.denoiseFeedback && options.denoiseIterations == 0) {
+        std::cerr << "--denoise-feedback requires at least one denoise iteration." << std::endl;
+        return false;
+    }
+    // a recorded session and its replays must generate the same random numbers
+    if (!options.seed && (!options.recordPath.empty() || !options.replayPath.empty())) {
+        options.seed = 0;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class CaptureFormat {
+    None,
+    // numbered PNG images in a directory
+    Png,
+    // raw YUV4MPEG2 video in a single file
+    Y4m,
+};
+
+// How the light update finds the light arriving at the faces.
+enum class GatherMode {
+    // a ray per sample of one random face per voxel, see light_update.glsl
+    Ray,
+    // all faces from the visibility found by sweeping the chunk on the GPU, see sweep_gather.glsl
+    Sweep,
+    // the same, but the sweep runs on the CPU
+    SweepCpu,
+};
+
+// Settings chosen on the command line.
+struct Options {
+    CaptureFormat captureFormat = CaptureFormat::None;
+    // directory for PNG sequences, file for Y4M video
+    std::string capturePath;
+    // frame rate written to the Y4M header
+    unsigned int captureFps = 60;
+    // start capturing on the first frame instead of waiting for F12
+    bool captureOnStart = false;
+
+    // file to record the per-frame inputs to
+    std::string recordPath;
+    // file to replay the per-frame inputs from instead of using live input
+    std::string replayPath;
+    // fixed deltaTime in milliseconds used during replay, 0 uses the recorded deltaTime
+    float timestep = 0.0f;
+    // seed for all random numbers, random if not set
+    std::optional<uint32_t> seed;
+    // CSV file to write per-frame timings and camera poses to
+    std::string frameLogPath;
+
+    // number of denoise iterations, 0 displays the raw colors
+    unsigned int denoiseIterations = 3;
+    // bounce light off the denoised colors instead of the raw ones
+    bool denoiseFeedback = false;
+    // how the light update finds the incoming light
+    GatherMode gather = GatherMode::Ray;
+    // frames between light updates of voxels that are not in view, 1 updates all voxels every frame
+    unsigned int priorityInterval = 4;
+    // rays cast by the light update per frame, 0 for no limit
+    unsigned int rayBudget = 0;
+    // verify every frame that each voxel is handled by exactly one light update pass,
+    // which waits for the GPU
+    bool checkSchedule = false;
+
+    // start with the rasterized meshes instead of ray casting (toggle with R)
+    bool raster = false;
+
+    // scene to display, see SCENES in scene.h
+    std::string scene = "outside";
+    // size of the chunks in one dimension, a multiple of VOXEL_WORKGROUP_SIZE in scene.h
+    unsigned int chunkSize = 32;
+    // scenes to bake in a single batch instead of displaying one,
+    // the materials are fixed per scene and cannot be varied between them
+    std::vector<std::string> bakeScenes;
+    // directory the baked scenes are written to
+    std::string bakeOutput = "bake";
+    // a scene is converged once its luminance changes by less than this fraction per frame
+    float bakeThreshold = 0.005f;
+    // a scene is written out after this many frames even if it has not converged
+    unsigned int bakeMaxFrames = 20000;
+};
+
+// Parses the command-line arguments into OPTIONS.
+// Returns false and prints the usage if the arguments are invalid.
+bool parseOptions(int argc, char** argv, Options& options);
@@ -1,12 +1,6 @@
 #pragma once
 
 #include "util.h"
-#include <GL/glew.h>
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_events.h>
-#include <SDL2/SDL_render.h>
-#include <SDL2/SDL_timer.h>
-#include <SDL2/SDL_video.h>
 #include <algorithm>
 #include <fstream>
 #include <glm/ext/quaternion_transform.hpp>
@@ -21,15 +15,6 @@
 #include <unordered_map>
 #include <unordered_set>
 
-const GLfloat QUAD_VERTICES[] = {
-    -1.0, -1.0,
-    1.0, -1.0,
-    -1.0, 1.0,
-    -1.0, 1.0,
-    1.0, 1.0,
-    1.0, -1.0
-};
-
 // OpenGL (std140 and std430) array elements are 16-byte aligned,
 // which C++ does not like, so force it with a wrapper.
 struct alignas(16) Vec3_16B {
@@ -48,22 +33,48 @@ struct alignas(16) Voxel {
     alignas(16) glm::uint flags;
 };
 
-// mirrored with shaders
-// size of the voxel chunk in one dimension
-const long CHUNK_SIZE = 32;
+// largest chunk size in one dimension, whose voxels take 480 MiB per scene.
+// The buffer sizes and indices that grow with the number of scenes are checked
+// against the limits of the driver when the chunks are created.
+const glm::uint MAX_CHUNK_SIZE = 128;
+// mirrored in light_update.glsl, denoise.glsl and sweep_gather.glsl
+// local size of the per-voxel compute shaders in each dimension,
+// the chunk size must be a multiple of it
+const glm::uint VOXEL_WORKGROUP_SIZE = 8;
+
+// mirrored in light_update.glsl and sweep.glsl
+// NOTE: 512+ causes shader compilation fail
+const glm::uint RANDOM_DIRECTION_COUNT = 16;
 
 // mirrored with shaders
 const int STORAGE_BUFFER_BINDING = 0;
-const glm::uvec3 WORKGROUP_SIZE = glm::uvec3(4, 4, 4);
+// per-face luminance variance, one float per face
+const int VARIANCE_BUFFER_BINDING = 1;
+// per-face denoised color and variance, one vec4 per face
+const int FILTERED_BUFFER_BINDING = 2;
+// input and output of one denoise iteration
+const int FILTER_INPUT_BINDING = 3;
+const int FILTER_OUTPUT_BINDING = 4;
+// light queries and their results
+const int LIGHT_QUERY_BINDING = 5;
+const int LIGHT_QUERY_RESULT_BINDING = 6;
+// per-scene convergence state, one SceneState per scene
+const int SCENE_STATE_BINDING = 7;
+// first solid voxel per cell and random direction, see sweep.h
+const int SWEEP_VISIBILITY_BINDING = 8;
+// PriorityCounters and a VoxelPriority per voxel of the displayed scene
+const int PRIORITY_BUFFER_BINDING = 9;
+// the chunk size, the only dimension the shaders are not compiled with
+const int CHUNK_INFO_BINDING = 10;
 
 // Scene where an inverted sphere represents the solid voxels and emissive voxels
 // are randomly chosen.
-inline Voxel invertedSphereScene(glm::uvec3 point)
+inline Voxel invertedSphereScene(glm::uvec3 point, glm::uint size, std::mt19937& random)
 {
-    glm::vec3 center = glm::vec3(CHUNK_SIZE) / 2.0f;
-    float radius = (float)CHUNK_SIZE / 2.0 - 1.0;
+    glm::vec3 center = glm::vec3(size) / 2.0f;
+    float radius = (float)size / 2.0 - 1.0;
     return Voxel {
-        .emission = glm::vec3(randf() < 0.03, randf() < 0.03, randf() < 0.03),
+        .emission = glm::vec3(randf(random) < 0.03, randf(random) < 0.03, randf(random) < 0.03),
         .diffuse = glm::vec3(1.0f),
         .dbFaceColor = {},
         .flags = glm::length(glm::vec3(point) - center) > radius ? 1u : 0u,
@@ -71,7 +82,7 @@ inline Voxel invertedSphereScene(glm::uvec3 point)
 }
 
 // Scene with a simple central light source and walls against the chunk boundaries.
-inline Voxel simpleScene(glm::uvec3 point)
+inline Voxel simpleScene(glm::uvec3 point, glm::uint size, std::mt19937&)
 {
     const Voxel WALL = Voxel {
         .emission = glm::vec3(),
@@ -89,9 +100,9 @@ inline Voxel simpleScene(glm::uvec3 point)
         .flags = 1u,
     };
 
-    glm::vec3 lightPosition = glm::vec3(CHUNK_SIZE) / 2.0f + glm::vec3(0.0f, CHUNK_SIZE / 4.0f, 0.0f);
-    float lightRadius = CHUNK_SIZE / 8.0f;
-    uint max = CHUNK_SIZE - 1;
+    glm::vec3 lightPosition = glm::vec3(size) / 2.0f + glm::vec3(0.0f, size / 4.0f, 0.0f);
+    float lightRadius = size / 8.0f;
+    uint max = size - 1;
 
     if (point.x == 0 || point.y == 0 || point.z == 0) {
         return WALL;
@@ -112,9 +123,9 @@ static inline bool isInCube(glm::uvec3 point, glm::uvec3 cubeMin, glm::uvec3 cub
 }
 
 // The Cornell box.
-inline Voxel cornellBoxScene(glm::uvec3 point)
+inline Voxel cornellBoxScene(glm::uvec3 point, glm::uint size, std::mt19937&)
 {
-    const auto N = CHUNK_SIZE;
+    const auto N = size;
     const Voxel RED_WALL = Voxel {
         .emission = glm::vec3(),
         .diffuse = glm::vec3(1.0f, 0.0f, 0.0f),
@@ -180,7 +191,7 @@ inline Voxel cornellBoxScene(glm::uvec3 point)
     return AIR;
 }
 
-inline Voxel outsideScene(glm::uvec3 point)
+inline Voxel outsideScene(glm::uvec3 point, glm::uint size, std::mt19937& random)
 {
     const Voxel AIR = Voxel {
         .flags = 0u,
@@ -189,12 +200,12 @@ inline Voxel outsideScene(glm::uvec3 point)
         // grass
         return Voxel {
             .emission = glm::vec3(),
-            .diffuse = glm::vec3(0.2f, 0.9f + randf() * 0.1f, 0.2f),
+            .diffuse = glm::vec3(0.2f, 0.9f + randf(random) * 0.1f, 0.2f),
             .dbFaceColor = {},
             .flags = 1u,
         };
     }
-    const uint N = CHUNK_SIZE;
+    const uint N = size;
     glm::vec3 torusCenter = glm::vec3(N / 2.0f, N / 8.0f, N / 2.0f);
     float torusOuterRadius = N / 3.0f;
     float torusInnerRadius = N / 18.0f;
@@ -212,20 +223,153 @@ inline Voxel outsideScene(glm::uvec3 point)
     return AIR;
 }
 
-// mirrored in frag.glsl
+// Generates the voxel at POINT of a chunk of SIZE in each dimension,
+// drawing random numbers from RANDOM.
+using SceneFunction = Voxel (*)(glm::uvec3 point, glm::uint size, std::mt19937& random);
+
+const std::pair<const char*, SceneFunction> SCENES[] = {
+    { "invertedSphere", invertedSphereScene },
+    { "simple", simpleScene },
+    { "cornellBox", cornellBoxScene },
+    { "outside", outsideScene },
+};
+
+// Returns the scene called NAME, or nullptr if there is none.
+inline SceneFunction findScene(const std::string& name)
+{
+    for (auto& [sceneName, scene] : SCENES) {
+        if (name == sceneName) {
+            return scene;
+        }
+    }
+    return nullptr;
+}
+
+// mirrored in common.glsl
+// fixed-point scale of the sums in SceneState, fine enough that the per-face
+// changes near convergence do not round to zero
+const double SCENE_CHANGE_SCALE = 1048576.0;
+
+// mirrored with shaders
+// Convergence of a scene while baking.
+struct SceneState {
+    // sum of the luminance change of all updated faces during a frame, in 1 / SCENE_CHANGE_SCALE,
+    // as a 64-bit number split into the low and the high word
+    glm::uint change[2];
+    // sum of the luminance of all updated faces during a frame, the same way
+    glm::uint luminance[2];
+    // non-zero once the scene has converged, which stops its light updates
+    glm::uint converged;
+
+    double getChange() const
+    {
+        return ((uint64_t)change[1] << 32 | change[0]) / SCENE_CHANGE_SCALE;
+    }
+
+    double getLuminance() const
+    {
+        return ((uint64_t)luminance[1] << 32 | luminance[0]) / SCENE_CHANGE_SCALE;
+    }
+};
+
+// mirrored with shaders
+// When a voxel was last on screen or lit one that was, used to prioritize its light updates.
+struct VoxelPriority {
+    // last frame in which a primary ray hit the voxel
+    glm::uint seenFrame;
+    // last frame in which a ray from a seen voxel hit the voxel, indexed by the frame's parity
+    glm::uint bounceFrames[2];
+    // last frame in which a light update pass handled the voxel
+    glm::uint handledFrame;
+};
+
+// mirrored with shaders
+// Per-frame counters at the start of the priority buffer, cleared every frame.
+struct PriorityCounters {
+    // rays cast, counted against the ray budget
+    glm::uint raysUsed;
+    // voxels handled by the light update passes and how many of them more than once,
+    // only counted when checking the schedule
+    glm::uint handled;
+    glm::uint duplicates;
+};
+
+
+// mirrored in common.glsl
+// The voxels of one scene. They are owned by an Arena, the chunk only refers to them.
 struct Chunk {
-    Voxel voxels[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+    // size of the chunk in one dimension
+    glm::uint size = 0;
+    // size³ voxels, in [x][y][z] order
+    Voxel* voxels = nullptr;
+
+    size_t voxelCount() const
+    {
+        return (size_t)size * size * size;
+    }
+
+    // number of faces in the per-face buffers
+    size_t faceCount() const
+    {
+        return voxelCount() * 6;
+    }
+
+    bool isInBounds(glm::ivec3 index) const
+    {
+        return glm::all(glm::greaterThanEqual(index, glm::ivec3(0))) && glm::all(glm::lessThan(index, glm::ivec3(size)));
+    }
+
+    // Returns the position of the voxel at INDEX in voxels.
+    // mirrored with cellIndex() in common.glsl
+    size_t cellIndex(glm::ivec3 index) const
+    {
+        return ((size_t)index.x * size + index.y) * size + index.z;
+    }
 
-    void init()
+    Voxel& at(glm::ivec3 index)
     {
-        glm::vec3 center = glm::vec3(CHUNK_SIZE) / 2.0f;
+        return voxels[cellIndex(index)];
+    }
 
-        for (uint32_t x = 0; x < CHUNK_SIZE; x++) {
-            for (uint32_t y = 0; y < CHUNK_SIZE; y++) {
-                for (uint32_t z = 0; z < CHUNK_SIZE; z++) {
-                    voxels[x][y][z] = outsideScene(glm::uvec3(x, y, z));
-                };
+    const Voxel& at(glm::ivec3 index) const
+    {
+        return voxels[cellIndex(index)];
+    }
+
+    // Returns false for voxels outside the chunk.
+    bool isSolid(glm::ivec3 index) const
+    {
+        if (!isInBounds(index)) {
+            return false;
+        }
+        return (at(index).flags & 1u) != 0;
+    }
+
+    // Generates the voxels of SCENE, one slice along x per task.
+    // Each slice draws from its own generator seeded from randomGenerator(), so
+    // the result does not depend on the threads. The memory is first touched
+    // here, by the thread that generates it.
+    void init(SceneFunction scene)
+    {
+        uint32_t seed = randomGenerator()();
+        parallelFor(size, [&](size_t x) {
+            std::seed_seq sequence { seed, (uint32_t)x };
+            std::mt19937 random { sequence };
+            for (glm::uint y = 0; y < size; y++) {
+                for (glm::uint z = 0; z < size; z++) {
+                    voxels[cellIndex(glm::ivec3(x, y, z))] = scene(glm::uvec3(x, y, z), size, random);
+                }
             }
+        });
+    }
+
+    // Returns the number of solid voxels.
+    size_t countSolid() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < voxelCount(); i++) {
+            count += voxels[i].flags & 1u;
         }
+        return count;
     }
 };
@@ -1,28 +1,64 @@
 #pragma once
 
 #include "input.h"
+#include "options.h"
+#include "simulation.h"
+#include "spsc.h"
+#include "trace.h"
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
-// Assumes App has functions init(), update(InputState& inputs, float deltaTime), destroy()
+// simulation steps per second, except when replaying
+const int SIMULATION_RATE = 240;
+
+// Assumes App has a constructor App(const Options&)
+// and functions init(), applyEdits(EditQueue&), update(const FrameState&), destroy()
 template <typename App>
 class SDLState {
 public:
-    SDLState()
+    SDLState(const Options& options)
+        : options { options }
+        , simulation { options }
+        , app { options }
     {
     }
 
     // Creates a window and OpenGL context.
     bool init();
     void destroy();
+    // Runs the simulation on the calling thread and renders on a second thread
+    // until the window is closed or the app exits.
+    //
+    // Events have to be polled on the main thread, so that is where the input
+    // is handled. The render thread owns the OpenGL context and draws the latest
+    // state published by the simulation, so GPU stalls do not delay the input.
     void run();
 
 private:
+    // Reads the events of one step into inputs.
+    // Returns false once the window is closed.
+    bool pollEvents(int width, int height, float deltaTime);
+    // Draws the published states until running is cleared or the app exits.
+    void render();
+
+    Options options;
     bool initialized = false;
     SDL_Window* window = nullptr;
     SDL_GLContext glContext = nullptr;
     InputState inputs;
+    Simulation simulation;
+    // states handed from the simulation to the render thread
+    TripleBuffer<FrameState> frames;
+    // cleared by either thread to stop both
+    std::atomic<bool> running { false };
+    // whether the simulation waits for every state to be rendered
+    bool lockstep = false;
+    TraceWriter recorder;
+    TraceReader replay;
+    FrameLog frameLog;
     App app;
 };
 
@@ -46,6 +82,8 @@ bool SDLState<App>::init()
     int width = 800;
     int height = 600;
 
+    // the rasterized render path needs a depth buffer
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
     window = SDL_CreateWindow("Voxel App", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
     if (window == nullptr) {
         logSDLError("Failed to create window.");
@@ -68,6 +106,19 @@ bool SDLState<App>::init()
 
     SDL_SetRelativeMouseMode(SDL_TRUE);
 
+    if (!options.replayPath.empty()) {
+        if (!replay.open(options.replayPath))
+            return false;
+    }
+    // vsync would hide performance differences and limit the bake throughput
+    if (!options.replayPath.empty() || !options.bakeScenes.empty()) {
+        SDL_GL_SetSwapInterval(0);
+    }
+    if (!options.recordPath.empty() && !recorder.open(options.recordPath))
+        return false;
+    if (!options.frameLogPath.empty() && !frameLog.open(options.frameLogPath))
+        return false;
+
     if (!app.init(width, height))
         return false;
 
@@ -78,6 +129,8 @@ bool SDLState<App>::init()
 template <typename App>
 void SDLState<App>::destroy()
 {
+    recorder.close();
+    frameLog.close();
     app.destroy();
     if (glContext)
         SDL_GL_DeleteContext(glContext);
@@ -87,66 +140,134 @@ void SDLState<App>::destroy()
 }
 
 template <typename App>
-void SDLState<App>::run()
+bool SDLState<App>::pollEvents(int width, int height, float deltaTime)
 {
-    const int FRAME_RATE = 3;
-    const float FRAME_TIME = 1.0 / FRAME_RATE;
+    // clear inputs for start of step
+    inputs.pressed.reset();
+    inputs.mouseDelta = glm::vec2(0.0f);
+
+    SDL_Event event;
+    // go through all events in the queue
+    while (SDL_PollEvent(&event)) {
+        SDL_Scancode key = event.key.keysym.scancode;
+        switch (event.type) {
+        case SDL_KEYDOWN:
+            if (!inputs.held[key]) {
+                inputs.pressed.set(key);
+            }
+            inputs.held.set(key);
+            break;
+        case SDL_KEYUP:
+            // a key that is pressed and released within one step still counts as pressed
+            inputs.held.reset(key);
+            break;
+        case SDL_MOUSEMOTION:
+            inputs.mouseDelta += glm::vec2((float)event.motion.xrel / width, (float)event.motion.yrel / height) * deltaTime;
+            break;
+        case SDL_QUIT:
+            return false;
+        }
+    }
+    return true;
+}
 
+template <typename App>
+void SDLState<App>::run()
+{
+    // a replay renders every step so that it is reproducible
+    lockstep = replay.isOpen();
+    Uint64 frequency = SDL_GetPerformanceFrequency();
     Uint64 last;
     Uint64 now = SDL_GetPerformanceCounter();
-    bool quit = false;
 
+    int width;
+    int height;
+    SDL_GetWindowSize(window, &width, &height);
+    // the render thread starts with a complete state
+    simulation.update(inputs, 0.0f, width, height, frames.back());
+    frames.publish();
+
+    // the render thread takes over the OpenGL context
+    SDL_GL_MakeCurrent(window, nullptr);
+    running = true;
+    std::thread renderThread(&SDLState<App>::render, this);
     std::cout << "App started." << std::endl;
 
-    while (!quit) {
+    while (running) {
         // get deltaTime
         last = now;
         now = SDL_GetPerformanceCounter();
-        float deltaTime = (double)((now - last) * 1000) / SDL_GetPerformanceFrequency();
+        float deltaTime = (double)((now - last) * 1000) / frequency;
 
-        // get window width/height
-        int width;
-        int height;
-        bool resized = false;
         SDL_GetWindowSize(window, &width, &height);
+        if (!pollEvents(width, height, deltaTime))
+            break;
 
-        // clear inputs for start of frame
-        // inputs.held.merge(inputs.pressed); // add pressed to held
-        inputs.pressed.clear();
-        inputs.mouseDelta = glm::vec2(0.0f);
-
-        SDL_Event event;
-        // go through all events in the queue
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-            case SDL_KEYDOWN:
-                if (!inputs.isHeld(event.key.keysym.sym)) {
-                    inputs.pressed.insert(event.key.keysym.sym);
-                }
-                inputs.held.insert(event.key.keysym.sym);
-                break;
-            case SDL_KEYUP:
-                inputs.pressed.erase(event.key.keysym.sym);
-                inputs.held.erase(event.key.keysym.sym);
-                break;
-            case SDL_MOUSEMOTION:
-                inputs.mouseDelta += glm::vec2((float)event.motion.xrel / width, (float)event.motion.yrel / height) * deltaTime;
-                break;
-            case SDL_WINDOWEVENT_RESIZED:
-                width = event.window.data1;
-                height = event.window.data2;
-                resized = true;
-                break;
-            case SDL_QUIT:
-                quit = true;
+        if (replay.isOpen()) {
+            // replace the live inputs with the recorded ones
+            float recordedDeltaTime;
+            if (!replay.read(inputs, recordedDeltaTime))
                 break;
+            deltaTime = options.timestep > 0.0f ? options.timestep : recordedDeltaTime;
+        } else if (recorder.isOpen()) {
+            recorder.write(inputs, deltaTime);
+        }
+
+        if (lockstep) {
+            // waits until the render thread has taken the previous state
+            while (frames.isFresh() && running) {
+                std::this_thread::yield();
+            }
+        }
+        simulation.update(inputs, deltaTime, width, height, frames.back());
+        frames.publish();
+
+        if (!lockstep) {
+            // steps at a steady rate no matter how long the frames take to render
+            Uint64 next = now + frequency / SIMULATION_RATE;
+            Uint64 current = SDL_GetPerformanceCounter();
+            if (current < next) {
+                SDL_Delay((next - current) * 1000 / frequency);
             }
         }
+    }
+    // the last replayed step is rendered as well
+    while (lockstep && frames.isFresh() && running) {
+        std::this_thread::yield();
+    }
+    running = false;
+    renderThread.join();
+    // destroy() runs on this thread
+    SDL_GL_MakeCurrent(window, glContext);
+}
+
+template <typename App>
+void SDLState<App>::render()
+{
+    SDL_GL_MakeCurrent(window, glContext);
+    Uint64 lastSwap = SDL_GetPerformanceCounter();
+    Uint64 frame = 0;
 
-        app.resize(width, height);
-        resized = false;
-        if (!app.update(inputs, deltaTime))
+    while (running) {
+        // without a new state the last one is drawn again, which still refines the lighting
+        if (!frames.update() && lockstep) {
+            std::this_thread::yield();
+            continue;
+        }
+        const FrameState& state = frames.front();
+        app.applyEdits(simulation.getEdits());
+        if (!app.update(state))
             break;
         SDL_GL_SwapWindow(window);
+
+        if (frameLog.isOpen()) {
+            Uint64 swap = SDL_GetPerformanceCounter();
+            double frameTime = (double)((swap - lastSwap) * 1000) / SDL_GetPerformanceFrequency();
+            frameLog.write(frame, state.deltaTime, frameTime, state.cameraPosition, state.cameraPitch, state.cameraYaw);
+            lastSwap = swap;
+        }
+        frame += 1;
     }
+    running = false;
+    SDL_GL_MakeCurrent(window, nullptr);
 }
@@ -2,64 +2,19 @@
 #include <GL/glew.h>
 #include <algorithm>
 #include <cassert>
-#include <fstream>
 #include <iostream>
-#include <regex>
-#include <sstream>
 #include <string>
 
-static const std::string SHADER_FOLDER = std::string(PROJECT_ROOT) + "/shaders/";
-
-bool readShader(const std::string name, std::string& out)
-{
-    std::ifstream file(SHADER_FOLDER + name);
-    if (!file.is_open()) {
-        std::cerr << "Error loading shader " << name << ": Failed to open file." << std::endl;
-        return false;
-    }
-    std::stringstream sstream;
-    sstream << file.rdbuf();
-    out = sstream.str();
-    return true;
-}
-
-// Replaces `#include "shader.glsl"` with the shader code itself.
-bool addIncludes(const std::string& source, std::string& result)
-{
-    const std::basic_regex regex("#include \".*\"\n");
-    auto begin = std::sregex_iterator(source.begin(), source.end(), regex);
-    result.clear();
-    std::size_t lastPos = 0;
-
-    // TODO: add #line directives
-    for (auto it = begin; it != std::sregex_iterator(); ++it) {
-        result += source.substr(lastPos, it->position() - lastPos);
-        lastPos = it->position() + it->length();
-        std::string match = it->str();
-        std::string includeSource;
-        if (!readShader(match.substr(10, match.length() - 12), includeSource)) {
-            return false;
-        }
-        result += includeSource;
-    }
-    result.append(source.substr(lastPos));
-    return true;
-}
-
 // type is either GL_VERTEX_SHADER, GL_FRAGMENT_SHADER or GL_COMPUTE_SHADER
 // path is the path to the shader file
 GLuint loadShader(GLenum type, const std::string name)
 {
     std::cout << "Loading shader " << name << std::endl;
-    std::string preIncludeSource;
+    std::string source;
 
-    if (!readShader(name, preIncludeSource)) {
+    if (!preprocessShader(name, source)) {
         return 0; // 0 means invalid OpenGL shader
     }
-    std::string source;
-    if (!addIncludes(preIncludeSource, source)) {
-        return 0;
-    }
     const char* rawSource = source.c_str();
 
     GLuint id = glCreateShader(type);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "shader_source.h"
 #include <GL/glew.h>
 #include <string>
 #include <vector>
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Reads the shader called NAME from the "shaders/" folder into OUT.
+bool readShader(const std::string name, std::string& out);
+// Replaces `#include "shader.glsl"` in SOURCE with the shader code itself.
+bool addIncludes(const std::string& source, std::string& result);
+// Reads the shader called NAME and resolves its includes, the part of loadShader() that needs no OpenGL context.
+bool preprocessShader(const std::string name, std::string& source);
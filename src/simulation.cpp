@@ -0,0 +1,45 @@
+#include "simulation.h"
+
+Simulation::Simulation(const Options& options)
+    // starts in the center of the chunk
+    : camera { glm::vec3(options.chunkSize) / 2.0f, 800, 600 }
+    , raster { options.raster }
+    , capturing { options.captureOnStart }
+{
+}
+
+void Simulation::update(const InputState& inputs, float deltaTime, uint width, uint height, FrameState& state)
+{
+    camera.resize(width, height);
+    camera.update(inputs, deltaTime);
+    if (inputs.isPressed(SDLK_F12)) {
+        capturing = !capturing;
+    }
+    if (inputs.isPressed(SDLK_r)) {
+        raster = !raster;
+    }
+
+    // every field is written since the buffer holds an older state
+    state.step = step;
+    state.deltaTime = deltaTime;
+    state.width = width;
+    state.height = height;
+    state.cameraPosition = camera.getPosition();
+    state.cameraRotation = camera.getRotation();
+    state.cameraPitch = camera.getPitch();
+    state.cameraYaw = camera.getYaw();
+    state.aspectRatio = camera.getAspectRatio();
+    state.raster = raster;
+    state.capturing = capturing;
+    step += 1;
+}
+
+bool Simulation::setVoxel(glm::ivec3 index, Voxel voxel)
+{
+    return edits.push(VoxelEdit { index, voxel });
+}
+
+EditQueue& Simulation::getEdits()
+{
+    return edits;
+}
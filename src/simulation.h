@@ -0,0 +1,74 @@
+#pragma once
+
+#include "camera.h"
+#include "input.h"
+#include "options.h"
+#include "scene.h"
+#include "spsc.h"
+#include <cstdint>
+#include <glm/mat3x3.hpp>
+#include <glm/vec3.hpp>
+
+// maximum number of voxel edits waiting for the render thread
+const size_t MAX_QUEUED_EDITS = 256;
+
+// A voxel replaced by the simulation.
+struct VoxelEdit {
+    glm::ivec3 index;
+    Voxel voxel;
+};
+
+using EditQueue = SpscQueue<VoxelEdit, MAX_QUEUED_EDITS>;
+
+// Everything the render thread needs from one simulation step.
+// Written by the simulation thread and only read once it is published.
+struct FrameState {
+    // number of simulation steps before this one
+    uint64_t step = 0;
+    // length of the step in milliseconds
+    float deltaTime = 0.0f;
+    // window size at the end of the step
+    uint width = 800;
+    uint height = 600;
+
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    glm::mat3 cameraRotation = glm::mat3(1.0f);
+    float cameraPitch = 0.0f;
+    float cameraYaw = 0.0f;
+    float aspectRatio = 1.0f;
+
+    // whether the rasterized meshes are drawn instead of casting rays
+    bool raster = false;
+    // whether frames are being captured
+    bool capturing = false;
+};
+
+// The part of the app that reacts to input, independent of OpenGL.
+//
+// Runs on the main thread, which polls the SDL events, while the render thread
+// owns the OpenGL context. Each step produces a FrameState, and voxel edits are
+// batched in a queue that the render thread drains before its next frame.
+// Light queries are not available here: App::queryLight() must be called on
+// the render thread, and there is no queue that forwards queries to it.
+class Simulation {
+public:
+    Simulation(const Options& options);
+
+    // Advances the simulation by DELTA_TIME milliseconds in a window of WIDTH x HEIGHT
+    // and writes the result to STATE.
+    void update(const InputState& inputs, float deltaTime, uint width, uint height, FrameState& state);
+
+    // Queues the replacement of the voxel at INDEX for the render thread.
+    // Returns false if the queue is full, in which case the edit should be repeated in a later step.
+    bool setVoxel(glm::ivec3 index, Voxel voxel);
+
+    // The edits that the render thread applies.
+    EditQueue& getEdits();
+
+private:
+    Camera camera;
+    EditQueue edits;
+    uint64_t step = 0;
+    bool raster = false;
+    bool capturing = false;
+};
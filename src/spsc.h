@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Hands the latest value from one producer thread to one consumer thread without locks.
+//
+// The producer fills back() and publishes it, the consumer takes the most recently
+// published value with update() and reads it through front(). A value published
+// while the consumer is still busy replaces the previous one, so neither side waits.
+template <typename T>
+class TripleBuffer {
+public:
+    // The value being written by the producer.
+    // Holds an older value after publish(), so it has to be written completely.
+    T& back()
+    {
+        return buffers[backIndex];
+    }
+
+    // Makes back() available to the consumer.
+    void publish()
+    {
+        uint8_t previous = shared.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+    }
+
+    // Switches front() to the most recently published value.
+    // Returns false if nothing was published since the last call.
+    bool update()
+    {
+        if ((shared.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        uint8_t previous = shared.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    // The value taken by the last update(), only to be used by the consumer.
+    const T& front() const
+    {
+        return buffers[frontIndex];
+    }
+
+    // Returns true while the consumer has not taken the last published value.
+    bool isFresh() const
+    {
+        return (shared.load(std::memory_order_acquire) & FRESH_BIT) != 0;
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 3;
+    // set in shared when it holds a value the consumer has not taken yet
+    static const uint8_t FRESH_BIT = 4;
+
+    T buffers[3];
+    // only used by the producer
+    uint8_t backIndex = 0;
+    // the buffer between the two threads and FRESH_BIT
+    alignas(64) std::atomic<uint8_t> shared { 1 };
+    // only used by the consumer
+    alignas(64) uint8_t frontIndex = 2;
+};
+
+// Fixed-capacity queue from one producer thread to one consumer thread
+// without locks or allocations.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+public:
+    // Appends VALUE, returning false if the queue is full.
+    bool push(const T& value)
+    {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        items[tail % CAPACITY] = value;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes the oldest value, returning false if the queue is empty.
+    bool pop(T& value)
+    {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = items[head % CAPACITY];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[CAPACITY];
+    // number of values taken and pushed since the start
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<size_t> tail { 0 };
+};
@@ -0,0 +1,86 @@
+#include "sweep.h"
+#include <cmath>
+#include <cstdlib>
+#include <glm/common.hpp>
+
+// mirrored in sweep_visibility.glsl
+// Offset of a line along a secondary axis after STEP steps along the principal axis.
+static int sweepOffset(float slope, int step)
+{
+    return (int)std::floor(0.5f + step * slope);
+}
+
+static glm::uint packHit(const Chunk& chunk, glm::ivec3 index, glm::uint face)
+{
+    return chunk.cellIndex(index) * 8 + face;
+}
+
+void sweepVisibility(const Chunk& chunk, glm::vec3 direction, glm::uint* visibility)
+{
+    glm::vec3 absDirection = glm::abs(direction);
+    // the lines advance one cell per step along the principal axis a
+    // and at most one cell along the other axes b and c
+    int a = 0;
+    if (absDirection.y > absDirection[a])
+        a = 1;
+    if (absDirection.z > absDirection[a])
+        a = 2;
+    if (absDirection[a] == 0.0f) {
+        return;
+    }
+    int b = (a + 1) % 3;
+    int c = (a + 2) % 3;
+    const int N = chunk.size;
+    int stepA = direction[a] < 0.0f ? -1 : 1;
+    float slopeB = direction[b] / absDirection[a];
+    float slopeC = direction[c] / absDirection[a];
+
+    // lines starting outside the chunk enter it further along
+    int endB = sweepOffset(slopeB, N - 1);
+    int endC = sweepOffset(slopeC, N - 1);
+    int countB = N + std::abs(endB);
+    int countC = N + std::abs(endC);
+    // face entered by a step along a
+    glm::uint faceA = a * 2 + (stepA < 0 ? 1 : 0);
+
+    for (int lineB = 0; lineB < countB; lineB++) {
+        for (int lineC = 0; lineC < countC; lineC++) {
+            int startB = lineB - std::max(endB, 0);
+            int startC = lineC - std::max(endC, 0);
+            glm::uint hit = SWEEP_MISS;
+            glm::ivec3 next = glm::ivec3(0);
+
+            // walks the line backwards so that every cell sees the nearest hit after it
+            for (int t = N - 1; t >= 0; t--) {
+                glm::ivec3 cell;
+                cell[a] = stepA > 0 ? t : N - 1 - t;
+                cell[b] = startB + sweepOffset(slopeB, t);
+                cell[c] = startC + sweepOffset(slopeC, t);
+
+                if (t < N - 1) {
+                    // a diagonal step passes the cells beside the line,
+                    // which are closer than the next cell
+                    glm::ivec3 delta = next - cell;
+                    if (delta[b] != 0 || delta[c] != 0) {
+                        for (int i = 0; i < 3; i++) {
+                            int axis = (a + i) % 3;
+                            glm::ivec3 side = cell;
+                            side[axis] += delta[axis];
+                            if (delta[axis] != 0 && chunk.isSolid(side)) {
+                                hit = packHit(chunk, side, axis * 2 + (delta[axis] < 0 ? 1 : 0));
+                                break;
+                            }
+                        }
+                    }
+                }
+                if (chunk.isInBounds(cell)) {
+                    visibility[chunk.cellIndex(cell)] = hit;
+                    if (chunk.isSolid(cell)) {
+                        hit = packHit(chunk, cell, faceA);
+                    }
+                }
+                next = cell;
+            }
+        }
+    }
+}
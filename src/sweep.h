@@ -0,0 +1,28 @@
+#pragma once
+
+#include "scene.h"
+#include <glm/vec3.hpp>
+
+// mirrored in sweep.glsl
+// marks cells from which a direction leads out of the chunk
+const glm::uint SWEEP_MISS = 0xffffffffu;
+// mirrored in sweep_visibility.glsl
+const unsigned int SWEEP_WORKGROUP_SIZE = 64;
+
+// Returns an upper bound of the number of lines parallel to a direction that
+// cross a chunk of CHUNK_SIZE in each dimension.
+inline size_t sweepMaxLines(glm::uint chunkSize)
+{
+    return 4 * (size_t)chunkSize * chunkSize;
+}
+
+// Finds the first solid voxel in DIRECTION from every cell of CHUNK, the CPU
+// version of sweep_visibility.glsl.
+//
+// The cells are split into rasterized lines parallel to DIRECTION, so a hit can
+// be one cell off from the one found by casting a ray from the cell center.
+//
+// Writes chunk.voxelCount() entries to VISIBILITY, indexed like the voxels of the
+// chunk. Each is the linear index of the hit voxel * 8 + the face that is hit,
+// or SWEEP_MISS.
+void sweepVisibility(const Chunk& chunk, glm::vec3 direction, glm::uint* visibility);
@@ -0,0 +1,157 @@
+#include "trace.h"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+template <typename T>
+static void writeValue(std::ofstream& file, T value)
+{
+    file.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, T& value)
+{
+    return (bool)file.read((char*)&value, sizeof(T));
+}
+
+bool TraceWriter::open(const std::string& path)
+{
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace " << path << " for writing." << std::endl;
+        return false;
+    }
+    file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    writeValue(file, TRACE_VERSION);
+    std::cout << "Recording inputs to " << path << "." << std::endl;
+    return true;
+}
+
+// Writes the scancodes of the keys set in KEYS.
+static void writeKeys(std::ofstream& file, const std::bitset<SDL_NUM_SCANCODES>& keys)
+{
+    for (int32_t key = 0; key < SDL_NUM_SCANCODES; key++) {
+        if (keys[key]) {
+            writeValue(file, key);
+        }
+    }
+}
+
+void TraceWriter::write(const InputState& inputs, float deltaTime)
+{
+    writeValue(file, deltaTime);
+    writeValue(file, inputs.mouseDelta.x);
+    writeValue(file, inputs.mouseDelta.y);
+    writeValue(file, (uint16_t)inputs.pressed.count());
+    writeValue(file, (uint16_t)inputs.held.count());
+    writeKeys(file, inputs.pressed);
+    writeKeys(file, inputs.held);
+    frames += 1;
+}
+
+void TraceWriter::close()
+{
+    if (file.is_open()) {
+        file.close();
+        std::cout << "Recorded " << frames << " frames of input." << std::endl;
+    }
+}
+
+bool TraceWriter::isOpen()
+{
+    return file.is_open();
+}
+
+bool TraceReader::open(const std::string& path)
+{
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace " << path << "." << std::endl;
+        return false;
+    }
+    char magic[sizeof(TRACE_MAGIC)];
+    file.read(magic, sizeof(magic));
+    readValue(file, version);
+    if (!file || std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || version == 0 || version > TRACE_VERSION) {
+        std::cerr << "Trace " << path << " is not a version 1 to " << TRACE_VERSION << " input trace." << std::endl;
+        file.close();
+        return false;
+    }
+    std::cout << "Replaying inputs from " << path << "." << std::endl;
+    return true;
+}
+
+bool TraceReader::read(InputState& inputs, float& deltaTime)
+{
+    uint16_t pressedCount = 0;
+    uint16_t heldCount = 0;
+    glm::vec2 mouseDelta;
+    if (!readValue(file, deltaTime) || !readValue(file, mouseDelta.x) || !readValue(file, mouseDelta.y)
+        || !readValue(file, pressedCount) || !readValue(file, heldCount)) {
+        return false;
+    }
+    inputs.mouseDelta = mouseDelta;
+    inputs.pressed.reset();
+    inputs.held.reset();
+    for (uint i = 0; i < pressedCount + heldCount; i++) {
+        int32_t key = 0;
+        if (!readValue(file, key)) {
+            std::cerr << "Trace ended in the middle of a step." << std::endl;
+            return false;
+        }
+        int32_t scancode = version == 1 ? SDL_GetScancodeFromKey(key) : key;
+        if (scancode < 0 || scancode >= SDL_NUM_SCANCODES) {
+            std::cerr << "Trace contains an invalid key " << key << "." << std::endl;
+            return false;
+        }
+        if (i < pressedCount) {
+            inputs.pressed.set(scancode);
+        } else {
+            inputs.held.set(scancode);
+        }
+    }
+    return true;
+}
+
+bool TraceReader::isOpen()
+{
+    return file.is_open();
+}
+
+bool FrameLog::open(const std::string& path)
+{
+    file.open(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open frame log " << path << " for writing." << std::endl;
+        return false;
+    }
+    file << "frame,delta_time_ms,frame_time_ms,x,y,z,pitch,yaw\n";
+    file << std::setprecision(9);
+    return true;
+}
+
+void FrameLog::write(uint64_t frame, float deltaTime, double frameTime, glm::vec3 position, float pitch, float yaw)
+{
+    file << frame << ',' << deltaTime << ',' << frameTime << ','
+         << position.x << ',' << position.y << ',' << position.z << ','
+         << pitch << ',' << yaw << '\n';
+    totalFrameTime += frameTime;
+    frames += 1;
+}
+
+void FrameLog::close()
+{
+    if (file.is_open()) {
+        file.close();
+        if (frames > 0) {
+            std::cout << "Logged " << frames << " frames, average frame time "
+                      << totalFrameTime / frames << " ms." << std::endl;
+        }
+    }
+}
+
+bool FrameLog::isOpen()
+{
+    return file.is_open();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "input.h"
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Binary input trace, one record per simulation step:
+// float deltaTime, float mouseDelta[2], uint16 pressedCount, uint16 heldCount,
+// followed by int32 keys[pressedCount + heldCount].
+// The keys are scancodes, version 1 traces store keycodes instead.
+// The file starts with TRACE_MAGIC and TRACE_VERSION.
+const char TRACE_MAGIC[4] = { 'V', 'X', 'T', 'R' };
+const uint32_t TRACE_VERSION = 2;
+
+// Records the per-step inputs so that a session can be replayed exactly.
+class TraceWriter {
+public:
+    bool open(const std::string& path);
+    void write(const InputState& inputs, float deltaTime);
+    void close();
+    bool isOpen();
+
+private:
+    std::ofstream file;
+    uint64_t frames = 0;
+};
+
+// Reads back the inputs written by TraceWriter.
+class TraceReader {
+public:
+    bool open(const std::string& path);
+    // Overwrites INPUTS and DELTA_TIME with the next step.
+    // Returns false at the end of the trace.
+    bool read(InputState& inputs, float& deltaTime);
+    bool isOpen();
+
+private:
+    std::ifstream file;
+    uint32_t version = 0;
+};
+
+// Writes per-frame timings and camera poses as CSV.
+class FrameLog {
+public:
+    bool open(const std::string& path);
+    // FRAME_TIME is the wall-clock time of the frame in milliseconds,
+    // POSITION, PITCH and YAW are the camera pose that was rendered.
+    void write(uint64_t frame, float deltaTime, double frameTime, glm::vec3 position, float pitch, float yaw);
+    void close();
+    bool isOpen();
+
+private:
+    std::ofstream file;
+    double totalFrameTime = 0.0;
+    uint64_t frames = 0;
+};
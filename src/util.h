@@ -1,17 +1,83 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+#include <glm/vec4.hpp>
 #include <random>
+#include <thread>
+#include <vector>
 
-inline float randf()
+// The generator used by all random functions.
+// Randomly seeded unless seedRandom() is called.
+inline std::mt19937& randomGenerator()
+{
+    static std::mt19937 gen { std::random_device {}() };
+    return gen;
+}
+
+// Makes all following random numbers reproducible.
+inline void seedRandom(uint32_t seed)
+{
+    randomGenerator().seed(seed);
+}
+
+inline float randf(std::mt19937& generator)
 {
-    auto gen = std::mt19937(std::random_device {}());
     auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
-    return dist(gen);
+    return dist(generator);
+}
+
+inline float randf()
+{
+    return randf(randomGenerator());
 }
 
 inline float randf_normal()
 {
-    auto gen = std::mt19937(std::random_device {}());
     auto dist = std::normal_distribution<float>(0.0f, 1.0f);
-    return dist(gen);
+    return dist(randomGenerator());
+}
+
+// Fills DIRECTIONS with COUNT random unit vectors, uniformly distributed on the
+// sphere and packed with glm::packSnorm4x8().
+inline void randomPackedDirections(glm::uint* directions, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        directions[i] = glm::packSnorm4x8(glm::vec4(
+            glm::normalize(glm::vec3(
+                randf_normal(),
+                randf_normal(),
+                randf_normal())),
+            // 0.0f as padding between array elements
+            0.0f));
+    }
+}
+
+// Calls FUNCTION(i) for every i in [0, COUNT) on as many threads as the hardware has.
+// FUNCTION must be safe to call concurrently for different i.
+template <typename Function>
+void parallelFor(size_t count, Function function)
+{
+    if (count == 0) {
+        return;
+    }
+    std::atomic<size_t> next = 0;
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+    size_t threadCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, count);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
 }